@@ -1,20 +1,109 @@
 /* radare nX-U8/100 analysis plugin - LGPL - Copyright 2020 - cetus9 */
 
 #include <string.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <r_types.h>
 #include <r_lib.h>
 #include <r_asm.h>
 #include <r_anal.h>
 
 #include "u8_disas.h"
+#include "u8_emu.h"
+#include "u8_disc.h"
+#include "u8_xref.h"
+#include "u8_db.h"
 
 // u8inst[U8_INS_NUM] contains instruction data
 
+// Decoded instruction cache. r2 calls u8_anop() for the same address many
+// times during aa/aaa/afb; entries are keyed by address plus the bytes
+// decoded, so patched code simply misses. Direct mapped, one entry per
+// slot; size with U8_ANAL_CACHE_BITS, watch 'a:u8.cache' hit rate.
+#ifndef U8_ANAL_CACHE_BITS
+#define U8_ANAL_CACHE_BITS	16
+#endif
+#define U8_ANAL_CACHE_SIZE	(1 << U8_ANAL_CACHE_BITS)
+
+struct u8_cache_ent
+{
+	ut64 addr;
+	ut8 bytes[6];		// instruction bytes, including any prefix
+	ut8 len;		// length in bytes, 0 if slot is empty
+	ut8 type;
+	ut16 op1;
+	ut16 op2;
+	ut16 s_word;
+	ut16 prefix;
+};
+
+static struct u8_cache_ent u8_cache[U8_ANAL_CACHE_SIZE];
+static ut64 u8_cache_hits, u8_cache_misses;
+
+static inline struct u8_cache_ent *u8_cache_slot(ut64 addr)
+{
+	return &u8_cache[((addr >> 1) ^ (addr >> (U8_ANAL_CACHE_BITS + 1))) & (U8_ANAL_CACHE_SIZE - 1)];
+}
+
+// u8_decode() through the cache
+static int u8_cached_decode(ut64 addr, const ut8 *buf, int len, struct u8_cmd *cmd)
+{
+	struct u8_cache_ent *e = u8_cache_slot(addr);
+	int ret;
+
+	if(e->len && e->addr == addr && e->len <= len && !memcmp(e->bytes, buf, e->len))
+	{
+		u8_cache_hits++;
+		cmd->type = e->type;
+		cmd->op1 = e->op1;
+		cmd->op2 = e->op2;
+		cmd->s_word = e->s_word;
+		cmd->prefix = e->prefix;
+		cmd->opcode = r_read_at_le16(e->bytes, e->prefix ? 2 : 0);
+		return cmd->len = e->len;
+	}
+
+	u8_cache_misses++;
+	ret = u8_decode(buf, len, cmd);
+	if(ret > 0)
+	{
+		e->addr = addr;
+		memcpy(e->bytes, buf, ret);
+		e->len = ret;
+		e->type = cmd->type;
+		e->op1 = cmd->op1;
+		e->op2 = cmd->op2;
+		e->s_word = cmd->s_word;
+		e->prefix = cmd->prefix;
+	}
+	return ret;
+}
+
+static void u8_cache_flush(void)
+{
+	memset(u8_cache, 0, sizeof(u8_cache));
+	u8_cache_hits = u8_cache_misses = 0;
+}
+
 // analyse opcodes
+// instruction type -> r2 op type, from u8_insn.def
+static const int u8_anal_type[U8_INS_NUM] =
+{
+#define U8_INSN(id, name, len, ops, flags, ins, ins_mask, op1_mask, op2_mask, fmt, anal) \
+	[U8_##id] = R_ANAL_OP_TYPE_##anal,
+#include "u8_insn.def"
+#undef U8_INSN
+};
+
+// swi #n handlers from the vector table, 0 until 'a:u8.vec' or 'a:u8.disc'
+// has read it
+static ut32 u8_swi_handler[64];
+
 static int u8_anop(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *buf, int len, RAnalOpMask mask)
 {
 	int ret;
 	struct u8_cmd cmd;
+	ut32 jump, fail;
 
 	memset (op, '\0', sizeof(RAnalOp));
 	op->size = -1;
@@ -27,272 +116,64 @@ static int u8_anop(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *buf, int len,
 	op->ptr = op->val = -1;
 	op->refptr = 0;
 
-	ret = op->size = u8_decode_opcode(buf, len, &cmd);
+	// structure only - operand strings are never used here
+	ret = op->size = u8_cached_decode(addr, buf, len, &cmd);
 
 	if(ret < 0)
 		return ret;
 
+	op->type = u8_anal_type[cmd.type];
+
+	// operand dependent details
 	switch(cmd.type)
 	{
-		// ADD instructions
-		case U8_ADD_R:
-		case U8_ADDC_R:
-		case U8_ADD_O:
-		case U8_ADDC_O:
-		case U8_ADD_ER:
-		case U8_ADD_ER_O:
-		case U8_ADD_SP_O:
-			op->type = R_ANAL_OP_TYPE_ADD; break;
-
-		// AND instructions
-		case U8_AND_R:
-		case U8_AND_O:
-			op->type = R_ANAL_OP_TYPE_AND; break;
-
-		// CMP instructions
-		case U8_CMP_R:
-		case U8_CMPC_R:
-		case U8_CMP_O:
-		case U8_CMPC_O:
-		case U8_CMP_ER:
-			op->type = R_ANAL_OP_TYPE_CMP; break;
-
-		// Register MOV instructions
-		case U8_MOV_R:
-		case U8_MOV_O:
-		case U8_MOV_ER:
-		case U8_MOV_ER_O:
-		case U8_MOV_ECSR_R:
-		case U8_MOV_ELR_ER:
-		case U8_MOV_EPSW_R:
-		case U8_MOV_ER_ELR:
-		case U8_MOV_ER_SP:
-		case U8_MOV_PSW_R:
-		case U8_MOV_PSW_O:
-		case U8_MOV_R_ECSR:
-		case U8_MOV_R_EPSW:
-		case U8_MOV_R_PSW:
-		case U8_MOV_SP_ER:
-
-		// Coprocessor MOV instructions
-		case U8_MOV_CR_R:
-		case U8_MOV_CER_EA:
-		case U8_MOV_CER_EAP:
-		case U8_MOV_CR_EA:
-		case U8_MOV_CR_EAP:
-		case U8_MOV_CXR_EA:
-		case U8_MOV_CXR_EAP:
-		case U8_MOV_CQR_EA:
-		case U8_MOV_CQR_EAP:
-		case U8_MOV_R_CR:
-		case U8_MOV_EA_CER:
-		case U8_MOV_EAP_CER:
-		case U8_MOV_EA_CR:
-		case U8_MOV_EAP_CR:
-		case U8_MOV_EA_CXR:
-		case U8_MOV_EAP_CXR:
-		case U8_MOV_EA_CQR:
-			op->type = R_ANAL_OP_TYPE_MOV; break;
-		case U8_OR_R:
-		case U8_OR_O:
-			op->type = R_ANAL_OP_TYPE_OR; break;
-		case U8_XOR_R:
-		case U8_XOR_O:
-			op->type = R_ANAL_OP_TYPE_XOR; break;
-		case U8_SUB_R:
-		case U8_SUBC_R:
-			op->type = R_ANAL_OP_TYPE_SUB; break;
-		case U8_SLL_R:
-		case U8_SLLC_R:
-		case U8_SLL_O:
-		case U8_SLLC_O:
-			op->type = R_ANAL_OP_TYPE_SHL; break;
-		case U8_SRA_R:
-		case U8_SRA_O:
-			op->type = R_ANAL_OP_TYPE_SAR; break;
-		case U8_SRL_R:
-		case U8_SRLC_R:
-		case U8_SRL_O:
-		case U8_SRLC_O:
-			op->type = R_ANAL_OP_TYPE_SHR; break;
-
-		// Load instructions
-		case U8_L_ER_EA:
-		case U8_L_ER_EAP:
-		case U8_L_ER_ER:
-		case U8_L_ER_D16_ER:
-		case U8_L_ER_D6_BP:
-		case U8_L_ER_D6_FP:
-		case U8_L_ER_DA:
-		case U8_L_R_EA:
-		case U8_L_R_EAP:
-		case U8_L_R_ER:
-		case U8_L_R_D16_ER:
-		case U8_L_R_D6_BP:
-		case U8_L_R_D6_FP:
-		case U8_L_R_DA:
-		case U8_L_XR_EA:
-		case U8_L_XR_EAP:
-		case U8_L_QR_EA:
-		case U8_L_QR_EAP:
-			op->type = R_ANAL_OP_TYPE_LOAD; break;
-
-		// Store instructions
-		case U8_ST_ER_EA:
-		case U8_ST_ER_EAP:
-		case U8_ST_ER_ER:
-		case U8_ST_ER_D16_ER:
-		case U8_ST_ER_D6_BP:
-		case U8_ST_ER_D6_FP:
-		case U8_ST_ER_DA:
-		case U8_ST_R_EA:
-		case U8_ST_R_EAP:
-		case U8_ST_R_ER:
-		case U8_ST_R_D16_ER:
-		case U8_ST_R_D6_BP:
-		case U8_ST_R_D6_FP:
-		case U8_ST_R_DA:
-		case U8_ST_XR_EA:
-		case U8_ST_XR_EAP:
-		case U8_ST_QR_EA:
-		case U8_ST_QR_EAP:
-			op->type = R_ANAL_OP_TYPE_STORE; break;
-
 		// Push/pop instructions
 		case U8_PUSH_ER:
 		case U8_PUSH_QR:
 		case U8_PUSH_R:
 		case U8_PUSH_XR:
 			op->stackop = R_ANAL_STACK_SET; 	// is this useful?
-			op->type = R_ANAL_OP_TYPE_PUSH; break;
+			break;
 		case U8_POP_ER:
 		case U8_POP_QR:
 		case U8_POP_R:
 		case U8_POP_XR:
 			op->stackop = R_ANAL_STACK_GET;
-			op->type = R_ANAL_OP_TYPE_POP; break;
-
-		// Register list stack instructions
-		// FIXME: programming model could be established here, from use of CSR, LCSR, ECSR
-		case U8_PUSH_RL:
-			op->type = R_ANAL_OP_TYPE_PUSH; break;
-
-		case U8_POP_RL:
-			// certain types of 'pop' may act as subroutine or interrupt returns
-			// (see nX-U8/100 Core Ref. Ch.1, S.4 - Exception Levels and Backup Registers)
-			switch(cmd.op1)
-			{
-				// FIXME: investigate 3, 7, a, b, f (also include pc).
-				case 0x2:	// pc (return type A-2)
-				case 0x6:	// psw, pc (return types B-1-2, C-1)
-				case 0xe:	// pc, psw, lr (return types B-2-2, C-2)
-					op->type = R_ANAL_OP_TYPE_RET;
-					break;
-
-				default:
-					op->type = R_ANAL_OP_TYPE_POP;
-					break;
-			}
 			break;
+	}
 
-		// EA register data transfer instructions
-		case U8_LEA_ER:
-		case U8_LEA_D16_ER:
-		case U8_LEA_DA:
-			op->type = R_ANAL_OP_TYPE_LEA; break;
-
-		// ALU Instructions
-		case U8_DAA_R:
-		case U8_DAS_R:
-		case U8_NEG_R:
-			op->type = R_ANAL_OP_TYPE_NULL; break;
-
-		// Bit access instructions
-		case U8_SB_R:
-		case U8_RB_R:
-		case U8_TB_R:
-		case U8_SB_DBIT:
-		case U8_RB_DBIT:
-		case U8_TB_DBIT:
-			op->type = R_ANAL_OP_TYPE_NULL; break;
-
-		// PSW access instructions      (no operands)
-		case U8_EI:
-		case U8_DI:
-		case U8_SC:
-		case U8_RC:
-		case U8_CPLC:
-			op->type = R_ANAL_OP_TYPE_NULL; break;
-
-		// Conditional relative branch instructions
-		case U8_BGE_RAD:
-		case U8_BLT_RAD:
-		case U8_BGT_RAD:
-		case U8_BLE_RAD:
-		case U8_BGES_RAD:
-		case U8_BLTS_RAD:
-		case U8_BGTS_RAD:
-		case U8_BLES_RAD:
-		case U8_BNE_RAD:
-		case U8_BEQ_RAD:
-		case U8_BNV_RAD:
-		case U8_BOV_RAD:
-		case U8_BPS_RAD:
-		case U8_BNS_RAD:
+	// type and branch targets of control flow - the same as a:u8.disc
+	// follows, so r2 and it agree on returns ('pop' lists with pc, see
+	// nX-U8/100 Core Ref. Ch.1, S.4) and on 'b Cadr' being a jump
+	switch(u8_flow(&cmd, addr, &jump, &fail))
+	{
+		case U8_FLOW_CJMP:
 			op->type = R_ANAL_OP_TYPE_CJMP;
-			op->jump = addr + sizeof(cmd.opcode) + 		// next instruction word, plus
-				((st8)cmd.op1 * sizeof(cmd.opcode));	//   op1 words (+ive or -ive)
-			op->fail = addr + sizeof(cmd.opcode);
+			op->jump = jump;
+			op->fail = fail;
 			break;
-		case U8_BAL_RAD:
+		case U8_FLOW_JMP:
 			op->type = R_ANAL_OP_TYPE_JMP;
-			op->jump = addr + sizeof(cmd.opcode) +		// next instruction word
-				((st8)cmd.op1 * sizeof(cmd.opcode));	//   op1 words (+ive or -ive)
-				// cannot fail
+			op->jump = jump;
 			break;
-		// Sign extension instruction
-		case U8_EXTBW_ER:
-			op->type = R_ANAL_OP_TYPE_NULL; break;
-
-		// Software interrupt instructions
-		case U8_SWI_O:
-			op->type = R_ANAL_OP_TYPE_SWI; break;
-		case U8_BRK:
-			op->type = R_ANAL_OP_TYPE_TRAP; break;
-		// Branch instructions
-		case U8_B_AD:
-			op->type = R_ANAL_OP_TYPE_CALL; break;
-		case U8_BL_AD:
-			// simulate segment register
-			op->jump = (cmd.op1 * 0x10000) + cmd.s_word;
-			op->type = R_ANAL_OP_TYPE_CALL; break;
-		case U8_B_ER:
-		case U8_BL_ER:
-			op->type = R_ANAL_OP_TYPE_RCALL; break;
-
-		// Multiplication and division instructions
-		case U8_MUL_ER:
-			op->type = R_ANAL_OP_TYPE_MUL; break;
-		case U8_DIV_ER:
-			op->type = R_ANAL_OP_TYPE_DIV; break;
-
-		// Miscellaneous (no operands)
-		case U8_INC_EA:
-		case U8_DEC_EA:
-			op->type = R_ANAL_OP_TYPE_NULL; break;
+		case U8_FLOW_CALL:
+			op->type = R_ANAL_OP_TYPE_CALL;
+			op->jump = jump;
+			break;
+		case U8_FLOW_RCALL:
+			op->type = R_ANAL_OP_TYPE_RCALL;
+			break;
+		case U8_FLOW_IJMP:
+			op->type = R_ANAL_OP_TYPE_RJMP;
+			break;
+		case U8_FLOW_SWI:
+			op->type = R_ANAL_OP_TYPE_SWI;
+			if(u8_swi_handler[cmd.op1 & 0x3f])
+				op->jump = u8_swi_handler[cmd.op1 & 0x3f];
+			break;
+		case U8_FLOW_RET:
+			op->type = R_ANAL_OP_TYPE_RET;
 			break;
-
-		// Return instructions
-		case U8_RT:
-		case U8_RTI:
-			op->type = R_ANAL_OP_TYPE_RET; break;
-		case U8_NOP:
-			op->type = R_ANAL_OP_TYPE_NOP; break;
-
-		case U8_ILL:
-		default:
-			op->type = R_ANAL_OP_TYPE_ILL;
-
 	}
 	return op->size;
 }
@@ -327,7 +208,7 @@ static ut8 *u8_anal_mask(RAnal *anal, int size, const ut8 *data, ut64 at)
 
 	for(i=0; i+1<size; i+=op->size)
 	{
-		op->size = u8_decode_opcode(data, size, &cmd);
+		op->size = u8_decode(data + i, size - i, &cmd);
 
 		if(op->size < 2)
 		{
@@ -349,6 +230,627 @@ static ut8 *u8_anal_mask(RAnal *anal, int size, const ut8 *data, ut64 at)
 	return ret;
 }
 
+// Emulator for 'a:u8.emu' commands, on a copy of the ROM read through io
+static struct u8_emu *u8_emu_state;
+static struct u8_emu_snap *u8_emu_snap;
+static ut8 *u8_emu_rom;
+
+static void u8_emu_free(void)
+{
+	if(u8_emu_state)
+	{
+		u8_emu_snap_free(u8_emu_state, u8_emu_snap);
+		u8_emu_fini(u8_emu_state);
+	}
+	u8_emu_snap = NULL;
+	free(u8_emu_state);
+	free(u8_emu_rom);
+	u8_emu_state = NULL;
+	u8_emu_rom = NULL;
+}
+
+static int u8_emu_load(RAnal *anal, ut32 size)
+{
+	u8_emu_free();
+
+	if(!size || size > U8_EMU_CODE_MAX)
+		size = U8_EMU_CODE_MAX;
+	if(!(u8_emu_rom = malloc(size)) || !(u8_emu_state = malloc(sizeof(*u8_emu_state))))
+	{
+		u8_emu_free();
+		return -1;
+	}
+	anal->iob.read_at(anal->iob.io, 0, u8_emu_rom, size);
+	if(u8_emu_init(u8_emu_state, u8_emu_rom, size) < 0)
+	{
+		free(u8_emu_state);
+		u8_emu_state = NULL;
+		u8_emu_free();
+		return -1;
+	}
+	return 0;
+}
+
+static void u8_emu_regs(RAnal *anal, struct u8_emu *e)
+{
+	int i;
+
+	for(i=0; i<16; i++)
+		anal->cb_printf("r%-2d %02x%s", i, e->r[i], (i % 8) == 7 ? "\n" : "  ");
+	anal->cb_printf("pc  %x:%04x  sp %04x  ea %04x  lr %x:%04x  psw %02x  dsr %02x\n",
+		e->csr, e->pc, e->sp, e->ea, e->lcsr, e->lr, e->psw, e->dsr);
+	anal->cb_printf("elr %x:%04x %x:%04x %x:%04x  epsw %02x %02x %02x  icount %"PFMT64u"\n",
+		e->ecsr[1], e->elr[1], e->ecsr[2], e->elr[2], e->ecsr[3], e->elr[3],
+		e->epsw[1], e->epsw[2], e->epsw[3], e->icount);
+	if(e->irq)
+		anal->cb_printf("irq pending %016"PFMT64x"\n", e->irq);
+}
+
+// 'a:u8.emu...' commands; 'cmd' is past "u8.emu"
+static void u8_emu_cmd(RAnal *anal, const char *cmd)
+{
+	char name[8];
+	ut64 max = UT64_MAX;
+	ut32 addr, val;
+	int stop, type;
+
+	if(*cmd == ' ' || !*cmd)
+	{
+		if(u8_emu_load(anal, strtoul(cmd, NULL, 16)) < 0)
+			anal->cb_printf("u8.emu: out of memory\n");
+		return;
+	}
+	if(!strcmp(cmd, "-"))
+	{
+		u8_emu_free();
+		return;
+	}
+	if(!u8_emu_state && strcmp(cmd, "?"))
+	{
+		anal->cb_printf("u8.emu: no emulator, run 'a:u8.emu' first\n");
+		return;
+	}
+
+	if(!strcmp(cmd, ".reset"))
+		u8_emu_reset(u8_emu_state);
+	else if(!strcmp(cmd, ".regs"))
+		u8_emu_regs(anal, u8_emu_state);
+	else if(sscanf(cmd, ".set %7s %x", name, &val) == 2)
+	{
+		if(u8_emu_reg_set(u8_emu_state, name, val) < 0)
+			anal->cb_printf("u8.emu: unknown register '%s'\n", name);
+	}
+	else if(sscanf(cmd, ".map %x %x %7s", &addr, &val, name) == 3)
+	{
+		type = !strcmp(name, "rom") ? U8_MEM_ROM : !strcmp(name, "ram") ? U8_MEM_RAM :
+			!strcmp(name, "sfr") ? U8_MEM_SFR : -1;
+		if(type < 0 || u8_emu_map(u8_emu_state, addr, val, type) < 0)
+			anal->cb_printf("u8.emu: bad mapping\n");
+	}
+	else if(!strcmp(cmd, ".snap"))
+	{
+		u8_emu_snap_free(u8_emu_state, u8_emu_snap);
+		if(!(u8_emu_snap = u8_emu_snap_take(u8_emu_state)))
+			anal->cb_printf("u8.emu: out of memory\n");
+	}
+	else if(!strcmp(cmd, ".snap-"))
+	{
+		if(u8_emu_snap)
+			u8_emu_snap_restore(u8_emu_state, u8_emu_snap);
+		else
+			anal->cb_printf("u8.emu: no snapshot\n");
+	}
+	else if(sscanf(cmd, ".irq %x", &addr) == 1)
+		u8_emu_irq(u8_emu_state, addr);
+	else if(sscanf(cmd, ".timer %x %x", &addr, &val) == 2)
+	{
+		// one timer per vector
+		if(!val)
+			u8_emu_event_del(u8_emu_state, addr);
+		else if(u8_emu_timer(u8_emu_state, addr, val, addr) < 0)
+			anal->cb_printf("u8.emu: too many events\n");
+	}
+	else if(!strcmp(cmd, ".trace-"))
+	{
+		if(u8_emu_trace_stop(u8_emu_state) < 0)
+			anal->cb_printf("u8.emu: error writing trace\n");
+	}
+	else if(!strncmp(cmd, ".trace ", 7))
+	{
+		for(cmd += 7; *cmd == ' '; cmd++)
+			;
+		if(u8_emu_trace_start(u8_emu_state, cmd) < 0)
+			anal->cb_printf("u8.emu: cannot create trace file\n");
+	}
+	else if(!strncmp(cmd, ".step", 5))
+	{
+		max = cmd[5] ? strtoull(cmd + 5, NULL, 0) : 1;
+		stop = u8_emu_run(u8_emu_state, max, U8_EMU_NO_ADDR);
+		anal->cb_printf("stop: %s\n", u8_emu_stop_name(stop));
+	}
+	else if(!strncmp(cmd, ".run", 4))
+	{
+		if(cmd[4])
+			max = strtoull(cmd + 4, NULL, 0);
+		stop = u8_emu_run(u8_emu_state, max, U8_EMU_NO_ADDR);
+		anal->cb_printf("stop: %s at %x:%04x\n", u8_emu_stop_name(stop), u8_emu_state->csr, u8_emu_state->pc);
+	}
+	else if(sscanf(cmd, ".call %x %"PFMT64u, &addr, &max) >= 1)
+	{
+		stop = u8_emu_call(u8_emu_state, addr, max);
+		anal->cb_printf("stop: %s\n", u8_emu_stop_name(stop));
+		u8_emu_regs(anal, u8_emu_state);
+	}
+	else
+	{
+		anal->cb_printf("| a:u8.emu [size]          load ROM from io (default 1M) and reset\n");
+		anal->cb_printf("| a:u8.emu-                free emulator\n");
+		anal->cb_printf("| a:u8.emu.reset           reset (SP, PC from vectors)\n");
+		anal->cb_printf("| a:u8.emu.regs            show registers\n");
+		anal->cb_printf("| a:u8.emu.set <reg> <v>   set register (r0, er2, sp, pc, psw, ...), hex\n");
+		anal->cb_printf("| a:u8.emu.map <addr> <size> rom|ram|sfr  data memory layout, 4K pages\n");
+		anal->cb_printf("| a:u8.emu.snap            snapshot registers and memory\n");
+		anal->cb_printf("| a:u8.emu.snap-           back to the snapshot\n");
+		anal->cb_printf("| a:u8.emu.irq <vec>        request interrupt (8 = NMI, a-7e maskable)\n");
+		anal->cb_printf("| a:u8.emu.timer <vec> <n>  interrupt every n instructions, 0 = off\n");
+		anal->cb_printf("| a:u8.emu.trace <file>    record executed instructions (list with u8trace)\n");
+		anal->cb_printf("| a:u8.emu.trace-          stop recording\n");
+		anal->cb_printf("| a:u8.emu.step [n]        execute n instructions\n");
+		anal->cb_printf("| a:u8.emu.run [max]       run to brk/illegal instruction\n");
+		anal->cb_printf("| a:u8.emu.call <addr> [max]  call routine, run until it returns\n");
+	}
+}
+
+// ROM image from io, 'cmd' is an optional size in hex (default 1M)
+static ut8 *u8_read_rom(RAnal *anal, const char *cmd, ut32 *size)
+{
+	ut8 *rom;
+
+	*size = 0;
+	sscanf(cmd, "%x", size);
+	if(!*size || *size > U8_DISC_CODE_MAX)
+		*size = U8_DISC_CODE_MAX;
+	if(!(rom = malloc(*size)))
+		return NULL;
+	anal->iob.read_at(anal->iob.io, 0, rom, *size);
+	return rom;
+}
+
+// Flag every vector table entry as 'vec.<name>' data and its handler as
+// '<name>', and note the swi handlers for u8_anop().
+//	returns the number of table entries
+static int u8_vec_apply(RAnal *anal, const ut8 *rom, ut32 size, struct u8_vector *vec)
+{
+	char name[32];
+	int i, n;
+
+	n = u8_vectors(rom, size, vec);
+	memset(u8_swi_handler, 0, sizeof(u8_swi_handler));
+	for(i=0; i<n; i++)
+	{
+		if(vec[i].kind == U8_VEC_SWI)
+			u8_swi_handler[i - U8_VEC_SWI_BASE / 2] = vec[i].target == U8_NO_ADDR ? 0 : vec[i].target;
+		if(vec[i].kind != U8_VEC_SP && vec[i].target == U8_NO_ADDR)
+			continue;
+		snprintf(name, sizeof(name), "vec.%s", vec[i].name);
+		anal->flb.set(anal->flb.f, name, vec[i].addr, 2);
+		r_meta_set(anal, R_META_TYPE_DATA, vec[i].addr, 2, NULL);
+		if(vec[i].kind != U8_VEC_SP)
+			anal->flb.set(anal->flb.f, vec[i].name, vec[i].target, 1);
+	}
+	return n;
+}
+
+// drop the flags u8_vec_apply() set for the slots in 'addr'..'addr+len-1',
+// before they are written
+static void u8_vec_unflag(RAnal *anal, const ut8 *rom, ut32 size, ut32 addr, ut32 len)
+{
+	struct u8_vector vec[U8_VECTORS];
+	char name[32];
+	int i, n;
+
+	n = u8_vectors(rom, size, vec);
+	for(i=0; i<n; i++)
+	{
+		if(vec[i].addr + 2 <= addr || vec[i].addr >= addr + len)
+			continue;
+		snprintf(name, sizeof(name), "vec.%s", vec[i].name);
+		anal->flb.unset_name(anal->flb.f, name);
+		if(vec[i].kind != U8_VEC_SP)
+			anal->flb.unset_name(anal->flb.f, vec[i].name);
+	}
+}
+
+// 'a:u8.vec [size]': show and flag the vector table
+static void u8_vec_cmd(RAnal *anal, const char *cmd)
+{
+	struct u8_vector vec[U8_VECTORS];
+	ut32 size;
+	ut8 *rom;
+	int i, n;
+
+	if(!(rom = u8_read_rom(anal, cmd, &size)))
+		return;
+	n = u8_vec_apply(anal, rom, size, vec);
+	for(i=0; i<n; i++)
+	{
+		if(vec[i].kind == U8_VEC_SP)
+			anal->cb_printf("%02x  %-8s %04x\n", vec[i].addr, vec[i].name, vec[i].target);
+		else if(vec[i].target != U8_NO_ADDR)
+			anal->cb_printf("%02x  %-8s %05x\n", vec[i].addr, vec[i].name, vec[i].target);
+	}
+	free(rom);
+}
+
+// Results of the last 'a:u8.disc', kept for 'a:u8.xref' and 'a:u8.patch'
+static struct u8_disc u8_disc_state;
+static struct u8_xrefs u8_xref_state;
+static ut8 *u8_disc_rom;
+
+#define U8_PATCH_RUN		64	// most bytes re-analysed in one go
+
+static int u8_func_cmp(const void *a, const void *b)
+{
+	const struct u8_disc_func *x = a, *y = b;
+
+	return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static void u8_disc_free(void)
+{
+	u8_xref_free(&u8_xref_state);
+	u8_disc_fini(&u8_disc_state);
+	free(u8_disc_rom);
+	u8_disc_rom = NULL;
+}
+
+static const int u8_xref_r2type[] =
+{
+	[U8_XREF_CALL] = R_ANAL_REF_TYPE_CALL,
+	[U8_XREF_JUMP] = R_ANAL_REF_TYPE_CODE,
+	[U8_XREF_CJMP] = R_ANAL_REF_TYPE_CODE,
+	[U8_XREF_READ] = R_ANAL_REF_TYPE_DATA,
+	[U8_XREF_WRITE] = R_ANAL_REF_TYPE_DATA,
+	[U8_XREF_ADDR] = R_ANAL_REF_TYPE_DATA,
+};
+
+// register function 'i' and its blocks with r2, named after the first
+// vector pointing to it
+//	returns 1 if added
+static int u8_disc_export_func(RAnal *anal, const struct u8_disc *d, ut32 i,
+	const struct u8_vector *vec, int nvec)
+{
+	RAnalFunction *fcn;
+	const struct u8_disc_block *b;
+	ut32 j;
+	char name[32];
+	int k;
+
+	if(r_anal_get_function_at(anal, d->func[i].addr))
+		return 0;
+	for(k=0; k<nvec && (vec[k].kind == U8_VEC_SP || vec[k].target != d->func[i].addr); k++)
+		;
+	if(k < nvec)
+		snprintf(name, sizeof(name), "%s", vec[k].name);
+	else
+		snprintf(name, sizeof(name), "fcn.%08x", d->func[i].addr);
+	if(!(fcn = r_anal_create_function(anal, name, d->func[i].addr, R_ANAL_FCN_TYPE_FCN, NULL)))
+		return 0;
+	for(j=0; j<d->func[i].nblocks; j++)
+	{
+		b = &d->block[d->func[i].blocks[j]];
+		r_anal_function_add_bb(anal, fcn, b->addr, b->size,
+			b->jump == U8_NO_ADDR ? UT64_MAX : b->jump,
+			b->fail == U8_NO_ADDR ? UT64_MAX : b->fail, NULL);
+	}
+	return 1;
+}
+
+// register all functions, their blocks and all xrefs with r2
+//	returns the number of functions added
+static ut32 u8_disc_export(RAnal *anal, const struct u8_disc *d, const struct u8_xrefs *x,
+	const struct u8_vector *vec, int nvec)
+{
+	const struct u8_xref *r;
+	ut32 i, added=0;
+
+	for(i=0; i<d->nfuncs; i++)
+		added += u8_disc_export_func(anal, d, i, vec, nvec);
+	for(i=0; i<x->nrefs; i++)
+	{
+		r = &x->ref[i];
+		r_anal_xrefs_set(anal, U8_XREF_FROM(r), r->to, u8_xref_r2type[U8_XREF_TYPE(r)]);
+	}
+	return added;
+}
+
+// Cache file for an image: $U8_CACHE_DIR/<hash>.u8db, default directory
+// $XDG_CACHE_HOME/u8 or ~/.cache/u8; U8_CACHE_DIR="" turns the cache off.
+//	returns 0, or -1 if there is no cache directory
+static int u8_db_path(char *path, size_t len, ut64 hash)
+{
+	const char *dir = getenv("U8_CACHE_DIR"), *base;
+	char buf[4096];
+
+	if(!dir)
+	{
+		if((base = getenv("XDG_CACHE_HOME")) && *base)
+			snprintf(buf, sizeof(buf), "%s", base);
+		else if((base = getenv("HOME")) && *base)
+			snprintf(buf, sizeof(buf), "%s/.cache", base);
+		else
+			return -1;
+		mkdir(buf, 0755);
+		strncat(buf, "/u8", sizeof(buf) - strlen(buf) - 1);
+		mkdir(buf, 0755);
+		dir = buf;
+	}
+	if(!*dir)
+		return -1;
+	return snprintf(path, len, "%s/%016"PFMT64x".u8db", dir, hash) < (int)len ? 0 : -1;
+}
+
+// 'a:u8.disc [size]': find code from every vector, index its xrefs and
+// register it all with r2 in one go. Results are kept in a cache file;
+// the same image again is a map of that file and the import.
+static void u8_disc_cmd(RAnal *anal, const char *cmd)
+{
+	struct u8_disc *d = &u8_disc_state;
+	struct u8_vector vec[U8_VECTORS];
+	struct timespec t0, t1;
+	ut32 roots[U8_VECTORS], size, added;
+	char path[4096];
+	int nvec, nroots=0, cached=0, has_path;
+
+	u8_disc_free();
+	if(!(u8_disc_rom = u8_read_rom(anal, cmd, &size)))
+		return;
+	nvec = u8_vec_apply(anal, u8_disc_rom, size, vec);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	has_path = !u8_db_path(path, sizeof(path), u8_db_hash(u8_disc_rom, size, 0));
+	if(has_path && !u8_db_load(path, d, &u8_xref_state, u8_disc_rom, size))
+		cached = 1;
+	else
+	{
+		nroots = u8_disc_vectors(u8_disc_rom, size, roots, U8_VECTORS);
+		if(u8_disc_init(d, u8_disc_rom, size) < 0 || u8_disc_run(d, roots, nroots, 0) < 0 ||
+			u8_xref_build(&u8_xref_state, d) < 0)
+		{
+			anal->cb_printf("u8.disc: out of memory\n");
+			u8_disc_free();
+			return;
+		}
+		if(has_path && u8_db_save(path, d, &u8_xref_state) < 0)
+			anal->cb_printf("u8.disc: cannot write %s\n", path);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	added = u8_disc_export(anal, d, &u8_xref_state, vec, nvec);
+	if(cached)
+		anal->cb_printf("%s: ", path);
+	else
+		anal->cb_printf("%d roots, ", nroots);
+	anal->cb_printf("%u functions (%u new), %u blocks, %"PFMT64u" instructions, %u xrefs in %.1f ms\n",
+		d->nfuncs, added, d->nblocks, d->ninsn, u8_xref_state.nrefs,
+		(t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+}
+
+// Bring the last 'a:u8.disc' and r2 up to date for image bytes
+// 'addr'..'addr+len-1' changed to 'buf': only what depends on them is
+// re-derived and registered again.
+//	returns 0, or -1 if out of memory (the results are then dropped)
+static int u8_patch_run(RAnal *anal, ut32 addr, const ut8 *buf, ut32 len)
+{
+	struct u8_disc *d = &u8_disc_state;
+	struct u8_xrefs *x = &u8_xref_state;
+	struct u8_vector vec[U8_VECTORS];
+	struct u8_disc_func *func=NULL;
+	const struct u8_xref *r;
+	RAnalFunction *fcn;
+	ut8 old[U8_PATCH_RUN];
+	ut32 i, j, a, nfuncs = d->nfuncs;
+	int nvec, dirty;
+
+	// old functions, to see which went or changed
+	if(nfuncs)
+	{
+		if(!(func = malloc(nfuncs * sizeof(*func))))
+			return -1;
+		memcpy(func, d->func, nfuncs * sizeof(*func));
+	}
+	memcpy(old, u8_disc_rom + addr, len);
+	if(addr < U8_VECTORS * 2)
+		u8_vec_unflag(anal, u8_disc_rom, d->size, addr, len);
+	memcpy(u8_disc_rom + addr, buf, len);
+	if(u8_disc_update(d, addr, old, len) < 0)
+	{
+		free(func);
+		return -1;
+	}
+
+	// xrefs from re-derived words
+	for(i=0; i<x->nrefs; i++)
+	{
+		r = &x->ref[i];
+		a = U8_XREF_FROM(r);
+		if(U8_DISC_BIT(d->dirty, a))
+			r_anal_xref_del(anal, a, r->to);
+	}
+	if(u8_xref_update(x, d) < 0)
+	{
+		free(func);
+		return -1;
+	}
+	for(i=0; i<x->nrefs; i++)
+	{
+		r = &x->ref[i];
+		a = U8_XREF_FROM(r);
+		if(U8_DISC_BIT(d->dirty, a))
+			r_anal_xrefs_set(anal, a, r->to, u8_xref_r2type[U8_XREF_TYPE(r)]);
+	}
+
+	// functions: gone, new, or with a block that changed
+	for(i=0; i<nfuncs; i++)
+	{
+		if(!bsearch(&func[i], d->func, d->nfuncs, sizeof(*d->func), u8_func_cmp) &&
+			(fcn = r_anal_get_function_at(anal, func[i].addr)))
+			r_anal_function_delete(fcn);
+	}
+	nvec = addr < U8_VECTORS * 2 ? u8_vec_apply(anal, u8_disc_rom, d->size, vec) :
+		u8_vectors(u8_disc_rom, d->size, vec);
+	for(i=0; i<d->nfuncs; i++)
+	{
+		const struct u8_disc_func *f = &d->func[i], *o;
+
+		o = bsearch(f, func, nfuncs, sizeof(*func), u8_func_cmp);
+		dirty = !o || o->size != f->size || o->nblocks != f->nblocks;
+		for(j=0; !dirty && j<f->nblocks; j++)
+		{
+			a = d->block[f->blocks[j]].addr;
+			dirty = U8_DISC_BIT(d->dirty, a);
+		}
+		if(!dirty)
+			continue;
+		if((fcn = r_anal_get_function_at(anal, f->addr)))
+			r_anal_function_delete(fcn);
+		u8_disc_export_func(anal, d, i, vec, nvec);
+	}
+	free(func);
+	return 0;
+}
+
+// 'a:u8.patch [<addr> <len>]': after writing to the image, re-analyse
+// what the changed bytes affect, with no full 'a:u8.disc'. Without a range
+// the whole image is compared with the one analysed. Nothing goes to the
+// cache file: code the patch cut off is kept, which a fresh run would not
+// find.
+static void u8_patch_cmd(RAnal *anal, const char *cmd)
+{
+	struct u8_disc *d = &u8_disc_state;
+	struct timespec t0, t1;
+	ut32 addr=0, len=0, i, end, same, runs=0, bytes=0;
+	ut8 *buf;
+
+	if(!u8_disc_rom)
+	{
+		anal->cb_printf("u8.patch: no results, run 'a:u8.disc' first\n");
+		return;
+	}
+	if(sscanf(cmd, "%x %x", &addr, &len) != 2)
+	{
+		addr = 0;
+		len = d->size;
+	}
+	if(addr >= d->size)
+		return;
+	if(len > d->size - addr)
+		len = d->size - addr;
+	if(!(buf = malloc(len)))
+		return;
+	anal->iob.read_at(anal->iob.io, addr, buf, len);
+
+	// runs of changed bytes, up to U8_PATCH_RUN long and ending at the
+	// first 8 unchanged ones
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(i=0; i<len; i=end)
+	{
+		if(buf[i] == u8_disc_rom[addr + i])
+		{
+			end = i + 1;
+			continue;
+		}
+		for(end=i+1, same=0; end < len && end - i < U8_PATCH_RUN && same < 8; end++)
+			same = buf[end] == u8_disc_rom[addr + end] ? same + 1 : 0;
+		end -= same;
+		if(u8_patch_run(anal, addr + i, buf + i, end - i) < 0)
+		{
+			anal->cb_printf("u8.patch: out of memory\n");
+			u8_disc_free();
+			free(buf);
+			return;
+		}
+		runs++;
+		bytes += end - i;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	free(buf);
+
+	anal->cb_printf("%u bytes in %u runs: %u functions, %u blocks, %"PFMT64u" instructions, %u xrefs in %.1f ms\n",
+		bytes, runs, d->nfuncs, d->nblocks, d->ninsn, u8_xref_state.nrefs,
+		(t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+}
+
+// 'a:u8.xref <addr>': refs to an address, from the last 'a:u8.disc'
+static void u8_xref_cmd(RAnal *anal, const char *cmd)
+{
+	static const char *names[] = { "call", "jump", "cjmp", "read", "write", "addr" };
+	const struct u8_xref *r;
+	ut32 addr, i, n;
+
+	if(sscanf(cmd, "%x", &addr) != 1)
+	{
+		anal->cb_printf("usage: a:u8.xref <addr>\n");
+		return;
+	}
+	if(!u8_xref_state.off)
+	{
+		anal->cb_printf("u8.xref: no index, run 'a:u8.disc' first\n");
+		return;
+	}
+	r = u8_xref_to(&u8_xref_state, addr, &n);
+	for(i=0; i<n; i++)
+		anal->cb_printf("%-5s %05x -> %05x\n", names[U8_XREF_TYPE(&r[i])], U8_XREF_FROM(&r[i]), r[i].to);
+}
+
+// plugin commands, run as 'a:<cmd>'
+static int u8_cmd(RAnal *anal, const char *cmd)
+{
+	int i, used=0;
+
+	if(strncmp(cmd, "u8", 2))
+		return false;
+	cmd += 2;
+
+	if(!strcmp(cmd, ".cache"))
+	{
+		for(i=0; i<U8_ANAL_CACHE_SIZE; i++)
+			used += (u8_cache[i].len != 0);
+
+		anal->cb_printf("entries %d/%d\n", used, U8_ANAL_CACHE_SIZE);
+		anal->cb_printf("hits %"PFMT64u"\n", u8_cache_hits);
+		anal->cb_printf("misses %"PFMT64u"\n", u8_cache_misses);
+		anal->cb_printf("hit rate %.1f%%\n", (u8_cache_hits + u8_cache_misses) ?
+			100.0 * u8_cache_hits / (u8_cache_hits + u8_cache_misses) : 0.0);
+	}
+	else if(!strcmp(cmd, ".cache-"))
+		u8_cache_flush();
+	else if(!strncmp(cmd, ".emu", 4))
+		u8_emu_cmd(anal, cmd + 4);
+	else if(!strncmp(cmd, ".disc", 5) && (!cmd[5] || cmd[5] == ' '))
+		u8_disc_cmd(anal, cmd + 5);
+	else if(!strcmp(cmd, ".disc-"))
+		u8_disc_free();
+	else if(!strncmp(cmd, ".vec", 4) && (!cmd[4] || cmd[4] == ' '))
+		u8_vec_cmd(anal, cmd + 4);
+	else if(!strncmp(cmd, ".xref ", 6))
+		u8_xref_cmd(anal, cmd + 6);
+	else if(!strncmp(cmd, ".patch", 6) && (!cmd[6] || cmd[6] == ' '))
+		u8_patch_cmd(anal, cmd + 6);
+	else
+	{
+		anal->cb_printf("| a:u8.cache     show decode cache statistics\n");
+		anal->cb_printf("| a:u8.cache-    flush decode cache, reset counters\n");
+		anal->cb_printf("| a:u8.vec [size]   show and flag the vector table\n");
+		anal->cb_printf("| a:u8.disc [size]  find functions from the vectors (ROM size, default 1M)\n");
+		anal->cb_printf("| a:u8.disc-        free discovery results\n");
+		anal->cb_printf("| a:u8.xref <addr>  refs to addr, from a:u8.disc\n");
+		anal->cb_printf("| a:u8.patch [<addr> <len>]  re-analyse changed bytes (default: all)\n");
+		anal->cb_printf("| a:u8.emu?      emulator commands\n");
+	}
+	return true;
+}
+
 struct r_anal_plugin_t r_anal_plugin_u8 =
 {
 	.name = "u8",
@@ -358,6 +860,7 @@ struct r_anal_plugin_t r_anal_plugin_u8 =
 	.bits = 8 | 16,
 	.anal_mask = u8_anal_mask,
 	.op = &u8_anop,
+	.cmd_ext = &u8_cmd,
 };
 
 #ifndef R2_PLUGIN_INCORE
@@ -10,18 +10,17 @@
 
 static int disassemble(RAsm *a, RAsmOp *op, const ut8 *buf, int len)
 {
-	struct u8_cmd cmd =
-	{
-        	.instr = "",
-        	.operands = ""
-	};
+	struct u8_cmd cmd;
+	char text[32];
 
 	if (len < 2) return -1;
-	int ret = u8_decode_opcode(buf, len, &cmd);
+	int ret = u8_decode(buf, len, &cmd);
 
 	if (ret > 0)
 	{
-		r_strbuf_set(&op->buf_asm, sdb_fmt("%s %s", cmd.instr, cmd.operands));
+		// single pass into a local buffer - no printf, reentrant
+		u8_format_asm(&cmd, text, sizeof(text));
+		r_strbuf_set(&op->buf_asm, text);
 	}
 	return op->size = ret;
 }
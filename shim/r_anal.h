@@ -0,0 +1,120 @@
+/* minimal r_anal.h for building without r2 - LGPL - Copyright 2020 - cetus9 */
+
+// RAnalOp, RAnal, the plugin struct and stubs for the analysis database
+// only, for calling u8_anop() and the a:u8 commands without r2 (bench).
+// Build anal_u8.c with -DR2_PLUGIN_INCORE against this.
+
+#ifndef R_ANAL_H
+#define R_ANAL_H
+
+#include "r_types.h"
+
+enum
+{
+	R_ANAL_OP_TYPE_NULL, R_ANAL_OP_TYPE_UNK, R_ANAL_OP_TYPE_ILL, R_ANAL_OP_TYPE_NOP,
+	R_ANAL_OP_TYPE_ADD, R_ANAL_OP_TYPE_SUB, R_ANAL_OP_TYPE_MUL, R_ANAL_OP_TYPE_DIV,
+	R_ANAL_OP_TYPE_AND, R_ANAL_OP_TYPE_OR, R_ANAL_OP_TYPE_XOR, R_ANAL_OP_TYPE_CMP,
+	R_ANAL_OP_TYPE_SHL, R_ANAL_OP_TYPE_SHR, R_ANAL_OP_TYPE_SAR, R_ANAL_OP_TYPE_MOV,
+	R_ANAL_OP_TYPE_LEA, R_ANAL_OP_TYPE_LOAD, R_ANAL_OP_TYPE_STORE,
+	R_ANAL_OP_TYPE_PUSH, R_ANAL_OP_TYPE_POP,
+	R_ANAL_OP_TYPE_JMP, R_ANAL_OP_TYPE_CJMP, R_ANAL_OP_TYPE_CALL, R_ANAL_OP_TYPE_RCALL,
+	R_ANAL_OP_TYPE_RJMP, R_ANAL_OP_TYPE_RET, R_ANAL_OP_TYPE_SWI, R_ANAL_OP_TYPE_TRAP
+};
+enum { R_ANAL_OP_FAMILY_CPU };
+enum { R_ANAL_FCN_TYPE_FCN = 1 };
+enum { R_META_TYPE_DATA = 'd' };
+enum { R_ANAL_REF_TYPE_CODE = 'c', R_ANAL_REF_TYPE_CALL = 'C', R_ANAL_REF_TYPE_DATA = 'd' };
+enum { R_ANAL_STACK_NULL, R_ANAL_STACK_GET, R_ANAL_STACK_SET };
+
+typedef int RAnalOpMask;
+
+typedef struct r_anal_op_t
+{
+	ut64 addr;
+	int size;
+	int type;
+	int family;
+	int stackop;
+	ut64 jump, fail;
+	st64 ptr, val;
+	int refptr;
+} RAnalOp;
+
+typedef struct r_io_bind_t
+{
+	void *io;
+	bool (*read_at)(void *io, ut64 addr, ut8 *buf, int len);
+} RIOBind;
+
+typedef struct r_flag_bind_t
+{
+	void *f;
+	void *(*set)(void *f, const char *name, ut64 addr, ut32 size);
+	bool (*unset_name)(void *f, const char *name);
+} RFlagBind;
+
+typedef struct r_anal_t
+{
+	PrintfCallback cb_printf;
+	RIOBind iob;
+	RFlagBind flb;
+} RAnal;
+
+struct r_anal_plugin_t
+{
+	const char *name, *desc, *license, *arch;
+	int bits;
+	ut8 *(*anal_mask)(RAnal *anal, int size, const ut8 *data, ut64 at);
+	int (*op)(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *buf, int len, RAnalOpMask mask);
+	int (*cmd_ext)(RAnal *anal, const char *cmd);
+};
+
+// functions, metadata and xrefs are not kept without r2
+typedef struct r_anal_function_t RAnalFunction;
+
+static inline bool r_meta_set(RAnal *anal, int type, ut64 addr, ut64 size, const char *str)
+{
+	return false;
+}
+
+static inline bool r_anal_xrefs_set(RAnal *anal, ut64 from, ut64 to, int type)
+{
+	return false;
+}
+
+static inline bool r_anal_xref_del(RAnal *anal, ut64 from, ut64 to)
+{
+	return false;
+}
+
+static inline RAnalFunction *r_anal_get_function_at(RAnal *anal, ut64 addr)
+{
+	return NULL;
+}
+
+static inline RAnalFunction *r_anal_create_function(RAnal *anal, const char *name, ut64 addr, int type, void *diff)
+{
+	return NULL;
+}
+
+static inline bool r_anal_function_delete(RAnalFunction *fcn)
+{
+	return false;
+}
+
+static inline bool r_anal_function_add_bb(RAnal *anal, RAnalFunction *fcn, ut64 addr, ut64 size, ut64 jump, ut64 fail, void *diff)
+{
+	return false;
+}
+
+static inline RAnalOp *r_anal_op_new(void)
+{
+	return calloc(1, sizeof(RAnalOp));
+}
+
+static inline void r_anal_op_free(void *op)
+{
+	free(op);
+}
+
+#endif /* R_ANAL_H */
@@ -0,0 +1,8 @@
+/* minimal r_asm.h for building without r2 - LGPL - Copyright 2020 - cetus9 */
+
+#ifndef R_ASM_H
+#define R_ASM_H
+
+#include "r_types.h"
+
+#endif /* R_ASM_H */
@@ -0,0 +1,8 @@
+/* minimal r_lib.h for building without r2 - LGPL - Copyright 2020 - cetus9 */
+
+#ifndef R_LIB_H
+#define R_LIB_H
+
+#include "r_types.h"
+
+#endif /* R_LIB_H */
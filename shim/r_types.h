@@ -0,0 +1,57 @@
+/* minimal r_types.h for building without r2 - LGPL - Copyright 2020 - cetus9 */
+
+// Just enough of radare2's headers to build the decoder, the anal op
+// callback and the tools around them (bench, libu8dis) with no r2 install.
+// Not used for the plugins themselves.
+
+#ifndef R_TYPES_H
+#define R_TYPES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+typedef uint8_t ut8;
+typedef uint16_t ut16;
+typedef uint32_t ut32;
+typedef uint64_t ut64;
+typedef int8_t st8;
+typedef int16_t st16;
+typedef int32_t st32;
+typedef int64_t st64;
+
+#define R_API
+#define PFMT64u		PRIu64
+#define PFMT64x		PRIx64
+#define PFMT64d		PRId64
+#define UT64_MAX	UINT64_MAX
+
+typedef int (*PrintfCallback)(const char *fmt, ...);
+
+static inline ut16 r_read_le16(const void *src)
+{
+	const ut8 *s = src;
+	return s[0] | (s[1] << 8);
+}
+
+static inline ut16 r_read_at_le16(const void *src, size_t offset)
+{
+	return r_read_le16((const ut8 *)src + offset);
+}
+
+static inline void r_write_le16(void *dest, ut16 val)
+{
+	ut8 *d = dest;
+	d[0] = val;
+	d[1] = val >> 8;
+}
+
+static inline void r_write_at_le16(void *dest, ut16 val, size_t offset)
+{
+	r_write_le16((ut8 *)dest + offset, val);
+}
+
+#endif /* R_TYPES_H */
@@ -0,0 +1,258 @@
+/* nX-U8/100 parallel batch emulation - LGPL - Copyright 2020 - cetus9 */
+
+// Many independent runs of a ROM routine spread over threads, for input
+// searches and function evaluation over a grid. Each thread works on a
+// u8_emu_clone() of the prototype: the ROM image and decode cache are
+// shared, registers and RAM are private. Every job starts from the
+// prototype state, restored from a per-thread snapshot.
+//
+// Jobs are handed out by work stealing. Each thread owns a range of job
+// numbers and takes them one at a time from the front; a thread that runs
+// out takes the back half of another thread's range. Ranges are a single
+// 64-bit word changed by compare-and-swap, and job results are summed per
+// thread, so the job loop takes no locks.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <r_types.h>
+
+#include "u8_emu.h"
+
+#define CHECK_JOBS		256		// jobs run by u8_batch_check()
+
+#define RANGE(lo, hi)		((ut64)(hi) << 32 | (lo))
+#define RANGE_LO(r)		((ut32)(r))
+#define RANGE_HI(r)		((ut32)((r) >> 32))
+
+struct batch_worker
+{
+	struct u8_emu e;
+	ut64 range;			// jobs lo..hi-1 left, shared
+	ut64 sum;			// job results
+	ut64 jobs;			// jobs run
+	struct batch *b;
+	int index;
+	pthread_t thread;
+	int threaded;
+	int error;
+} __attribute__((aligned(64)));
+
+struct batch
+{
+	struct u8_emu *proto;
+	struct batch_worker *w;
+	int nworkers;
+	u8_emu_job_fn job;
+	void *arg;
+};
+
+// next job from our own range
+static int batch_take(struct batch_worker *w, ut32 *job)
+{
+	ut64 r = __atomic_load_n(&w->range, __ATOMIC_ACQUIRE);
+
+	while(RANGE_LO(r) < RANGE_HI(r))
+	{
+		if(__atomic_compare_exchange_n(&w->range, &r, RANGE(RANGE_LO(r) + 1, RANGE_HI(r)),
+				0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			*job = RANGE_LO(r);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// move the back half of another worker's range to ours
+//	returns 0 when no work is left anywhere
+static int batch_steal(struct batch_worker *w)
+{
+	struct batch *b = w->b;
+	struct batch_worker *v;
+	ut32 lo, hi, mid;
+	ut64 r;
+	int k;
+
+	for(k=1; k<b->nworkers; k++)
+	{
+		v = &b->w[(w->index + k) % b->nworkers];
+		r = __atomic_load_n(&v->range, __ATOMIC_ACQUIRE);
+		while((lo = RANGE_LO(r)) < (hi = RANGE_HI(r)))
+		{
+			mid = lo + (hi - lo) / 2;
+			if(__atomic_compare_exchange_n(&v->range, &r, RANGE(lo, mid),
+					0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			{
+				__atomic_store_n(&w->range, RANGE(mid, hi), __ATOMIC_RELEASE);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static void *batch_worker(void *arg)
+{
+	struct batch_worker *w = arg;
+	struct batch *b = w->b;
+	struct u8_emu_snap *snap;
+	ut32 job;
+
+	if(!(snap = u8_emu_snap_take(&w->e)))
+	{
+		w->error = 1;
+		return NULL;
+	}
+
+	do
+	{
+		while(batch_take(w, &job))
+		{
+			u8_emu_snap_restore(&w->e, snap);
+			w->sum += b->job(&w->e, job, b->arg);
+			w->jobs++;
+		}
+	} while(batch_steal(w));
+
+	u8_emu_snap_free(&w->e, snap);
+	return NULL;
+}
+
+// Run jobs 0..njobs-1 on 'nthreads' threads (0 = one per CPU), each on a
+// copy of 'proto' in its current state. job() sets up the inputs, runs the
+// emulator and returns a value; the values of all jobs are summed into
+// *sum if given. Jobs that need more than a sum write to their own slot of
+// an array passed in 'arg'.
+//	returns the number of jobs run, or -1 if out of memory
+st64 u8_emu_batch(struct u8_emu *proto, ut64 njobs, int nthreads, u8_emu_job_fn job, void *arg, ut64 *sum)
+{
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	struct batch b;
+	ut64 per, lo=0, total=0, jobs=0;
+	int k, error=0, made=0;
+
+	if(njobs > UINT32_MAX)
+		njobs = UINT32_MAX;
+	if(nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if((ut64)nthreads > njobs)
+		nthreads = njobs ? njobs : 1;
+
+	b.proto = proto;
+	b.nworkers = nthreads;
+	b.job = job;
+	b.arg = arg;
+	if(posix_memalign((void **)&b.w, 64, nthreads * sizeof(*b.w)))
+		return -1;
+	memset(b.w, 0, nthreads * sizeof(*b.w));
+
+	// the clones translate into the prototype's cache, one at a time
+	proto->lock = &lock;
+
+	per = njobs / nthreads;
+	for(k=0; k<nthreads; k++, made++)
+	{
+		if(u8_emu_clone(&b.w[k].e, proto) < 0)
+		{
+			error = 1;
+			break;
+		}
+		b.w[k].b = &b;
+		b.w[k].index = k;
+		b.w[k].range = RANGE(lo, k == nthreads-1 ? njobs : lo + per);
+		lo += per;
+	}
+
+	if(!error)
+	{
+		// first worker runs on the calling thread
+		for(k=1; k<nthreads; k++)
+			b.w[k].threaded = !pthread_create(&b.w[k].thread, NULL, batch_worker, &b.w[k]);
+		for(k=0; k<nthreads; k++)
+		{
+			if(!b.w[k].threaded)
+				batch_worker(&b.w[k]);
+		}
+		for(k=1; k<nthreads; k++)
+		{
+			if(b.w[k].threaded)
+				pthread_join(b.w[k].thread, NULL);
+		}
+	}
+
+	for(k=0; k<made; k++)
+	{
+		total += b.w[k].sum;
+		jobs += b.w[k].jobs;
+		error |= b.w[k].error;
+		u8_emu_fini(&b.w[k].e);
+	}
+	free(b.w);
+	proto->lock = NULL;
+
+	if(sum)
+		*sum = total;
+	return error ? -1 : (st64)jobs;
+}
+
+// u8_batch_check() job: stores words to the stack and to 9200h, and
+// returns its input plus what it found at 9200h - 0 unless the previous
+// job's store survived the snapshot restore
+static ut64 check_job(struct u8_emu *e, ut64 job, void *arg)
+{
+	e->r[0] = job + 1;
+	e->r[1] = (job + 1) >> 8;
+	if(u8_emu_call(e, 0x10, 100) != U8_EMU_UNTIL)
+		return 1ULL << 40;
+	return e->r[2] | e->r[3] << 8;
+}
+
+// Self-check run by u8_bench: jobs that write RAM, on several threads,
+// against the same jobs run one at a time on a fresh emulator each.
+//	returns number of failed checks, -1 if out of memory
+int u8_batch_check(void)
+{
+	// push er0 ; pop er2 ; l er6, 9200h ; st er0, 9200h ; add er2, er6 ; rt
+	static const ut16 code[] = {0xf05e, 0xf21e, 0x9612, 0x9200, 0x9013, 0x9200, 0xf266, 0xfe1f};
+	struct u8_emu *e;
+	ut8 rom[0x40];
+	ut64 job, sum, ref=0;
+	int i, bad=0;
+
+	memset(rom, 0xff, sizeof(rom));
+	r_write_at_le16(rom, 0x9000, 0);		// SP
+	r_write_at_le16(rom, 0x0010, 2);
+	for(i=0; i<8; i++)
+		r_write_at_le16(rom, code[i], 0x10 + i*2);
+
+	if(!(e = malloc(sizeof(*e))))
+		return -1;
+	for(job=0; job<CHECK_JOBS; job++)
+	{
+		if(u8_emu_init(e, rom, sizeof(rom)) < 0)
+		{
+			free(e);
+			return -1;
+		}
+		u8_emu_reset(e);
+		ref += check_job(e, job, NULL);
+		u8_emu_fini(e);
+	}
+	if(ref != CHECK_JOBS * (CHECK_JOBS + 1) / 2)
+		bad++;
+
+	if(u8_emu_init(e, rom, sizeof(rom)) < 0)
+	{
+		free(e);
+		return -1;
+	}
+	u8_emu_reset(e);
+	if(u8_emu_batch(e, CHECK_JOBS, 4, check_job, NULL, &sum) != CHECK_JOBS || sum != ref)
+		bad++;
+	u8_emu_fini(e);
+	free(e);
+	return bad;
+}
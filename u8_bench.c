@@ -0,0 +1,269 @@
+/* nX-U8/100 decoder benchmark - LGPL - Copyright 2020 - cetus9 */
+
+// Standalone timing of the decode paths, built against shim/ (no r2):
+//
+//	u8_decode_inst	- instruction type of one word
+//	u8_decode_opcode	- linear decode + format of a buffer
+//	u8_anop		- r2 anal op callback, cache flushed per pass
+//	u8_anop_cached	- same, cache warm (repeat analysis of the same code)
+//
+// over random words, the exhaustive 2^16 sweep and any ROM images given
+// on the command line. Results go to stdout as JSON; see 'make bench'.
+//
+//	u8_bench [-t ms] [rom.bin ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <r_types.h>
+#include <r_anal.h>
+
+#include "u8_disas.h"
+#include "u8_emu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define U8_BENCH_TSC
+#endif
+
+#ifndef U8_DECODER_NAME
+#define U8_DECODER_NAME		"unknown"
+#endif
+
+#define RANDOM_WORDS		0x100000
+
+extern struct r_anal_plugin_t r_anal_plugin_u8;
+
+struct bench_input
+{
+	const char *name;
+	ut8 *buf;
+	int len;		// in bytes, even
+};
+
+// keeps results live so the compiler cannot drop the work
+static volatile ut64 bench_sink;
+
+static int bench_ms = 200;	// minimum run time per measurement
+static int first_result = 1;
+
+static ut64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ut64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static ut64 now_cycles(void)
+{
+#ifdef U8_BENCH_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static int quiet_printf(const char *fmt, ...)
+{
+	return 0;
+}
+
+// one pass over the input, returns number of instructions handled
+typedef ut64 (*bench_fn)(const struct bench_input *in);
+
+// run before each pass, outside the timed part
+typedef void (*bench_setup_fn)(void);
+
+static ut64 pass_decode_inst(const struct bench_input *in)
+{
+	ut64 sum=0;
+	int i;
+
+	for(i=0; i+1<in->len; i+=2)
+		sum += u8_decode_inst(r_read_at_le16(in->buf, i));
+	bench_sink += sum;
+
+	return in->len / 2;
+}
+
+static ut64 pass_decode_opcode(const struct bench_input *in)
+{
+	struct u8_cmd cmd;
+	ut64 n=0;
+	int i, ret;
+
+	for(i=0; i+1<in->len; i+=ret, n++)
+	{
+		ret = u8_decode_opcode(in->buf + i, in->len - i, &cmd);
+		if(ret < 2)
+			ret = 2;
+		bench_sink += cmd.operands[0];
+	}
+
+	return n;
+}
+
+static ut64 pass_anop(const struct bench_input *in)
+{
+	RAnalOp op;
+	ut64 n=0;
+	int i, ret;
+
+	for(i=0; i+1<in->len; i+=ret, n++)
+	{
+		ret = r_anal_plugin_u8.op(NULL, &op, i, in->buf + i, in->len - i, 0);
+		if(ret < 2)
+			ret = 2;
+		bench_sink += op.type;
+	}
+
+	return n;
+}
+
+// every pass of u8_anop starts on an empty decode cache
+static void cache_flush(void)
+{
+	RAnal anal = {quiet_printf};
+
+	r_anal_plugin_u8.cmd_ext(&anal, "u8.cache-");
+}
+
+// repeat passes for at least bench_ms, print one JSON result
+static void bench_run(const char *fn_name, bench_fn fn, bench_setup_fn setup, const struct bench_input *in)
+{
+	ut64 t0, t1, c0, c1, n=0, best_ns=UT64_MAX, best_cyc=0, best_n=1, pass_n;
+	int passes=0;
+
+	fn(in);					// warm up
+	t0 = now_ns();
+	do
+	{
+		if(setup)
+			setup();
+		c0 = now_cycles();
+		t1 = now_ns();
+		pass_n = fn(in);
+		c1 = now_cycles();
+		t1 = now_ns() - t1;
+
+		// best pass - least disturbed by the rest of the system
+		if(pass_n && t1 * best_n < best_ns * pass_n)
+		{
+			best_ns = t1;
+			best_cyc = c1 - c0;
+			best_n = pass_n;
+		}
+		n += pass_n;
+		passes++;
+	} while(now_ns() - t0 < (ut64)bench_ms * 1000000);
+
+	printf("%s\n\t\t{\"function\": \"%s\", \"input\": \"%s\", \"instructions\": %"PFMT64u
+		", \"passes\": %d, \"decodes_per_sec\": %.0f, \"ns_per_inst\": %.3f, \"cycles_per_inst\": %.3f}",
+		first_result ? "" : ",", fn_name, in->name, best_n, passes,
+		best_n * 1e9 / best_ns, (double)best_ns / best_n, (double)best_cyc / best_n);
+	first_result = 0;
+}
+
+static void bench_input(const struct bench_input *in)
+{
+	bench_run("u8_decode_inst", pass_decode_inst, NULL, in);
+	bench_run("u8_decode_opcode", pass_decode_opcode, NULL, in);
+	bench_run("u8_anop", pass_anop, cache_flush, in);
+	bench_run("u8_anop_cached", pass_anop, NULL, in);
+}
+
+static int load_rom(const char *path, struct bench_input *in)
+{
+	FILE *f;
+	long size;
+
+	if(!(f = fopen(path, "rb")))
+		return -1;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f) & ~1;
+	rewind(f);
+
+	in->name = path;
+	in->len = size;
+	if(size <= 0 || !(in->buf = malloc(size)) || fread(in->buf, 1, size, f) != size)
+	{
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	return 0;
+}
+
+// escape a string for JSON output
+static void json_str(const char *s)
+{
+	putchar('"');
+	for(; *s; s++)
+	{
+		if(*s == '"' || *s == '\\')
+			putchar('\\');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_input in;
+	ut32 seed = 0x55aa1234;
+	int i, argi=1;
+	ut16 w;
+
+	if(argc > 2 && !strcmp(argv[1], "-t"))
+	{
+		bench_ms = atoi(argv[2]);
+		argi = 3;
+	}
+
+	printf("{\n\t\"decoder\": \"%s\",\n\t\"compiler\": ", U8_DECODER_NAME);
+	json_str(__VERSION__);
+	printf(",\n\t\"tsc\": %s,\n\t\"classify_check\": %d,\n\t\"emu_check\": %d,\n\t\"batch_check\": %d,\n\t\"results\": [",
+		now_cycles() ? "true" : "false", u8_classify_check(), u8_emu_check(), u8_batch_check());
+
+	// fixed-seed random words - same stream on every run
+	in.name = "random";
+	in.len = RANDOM_WORDS * 2;
+	if(!(in.buf = malloc(in.len)))
+		return 1;
+	for(i=0; i<in.len; i+=2)
+	{
+		seed = seed * 1103515245 + 12345;
+		in.buf[i] = seed >> 16;
+		in.buf[i+1] = seed >> 24;
+	}
+	bench_input(&in);
+
+	// every word once, in order
+	in.name = "sweep";
+	in.len = 0x20000;
+	for(i=0; i<0x10000; i++)
+	{
+		w = i;
+		in.buf[i*2] = w;
+		in.buf[i*2 + 1] = w >> 8;
+	}
+	bench_input(&in);
+	free(in.buf);
+
+	for(; argi<argc; argi++)
+	{
+		if(load_rom(argv[argi], &in) < 0)
+		{
+			fprintf(stderr, "u8_bench: cannot read %s\n", argv[argi]);
+			continue;
+		}
+		bench_input(&in);
+		free(in.buf);
+	}
+
+	printf("\n\t]\n}\n");
+	return 0;
+}
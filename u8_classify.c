@@ -0,0 +1,244 @@
+/* nX-U8/100 bulk opcode classification - LGPL - Copyright 2020 - cetus9 */
+
+// Classifies every 16-bit word of a buffer into instruction type and
+// length, as u8_decode_inst() would for that word taken as a first word.
+// Most words are decided by their high nibble plus one other nibble
+// (u8_nib_* tables, generated from u8inst[] by u8_gen); these are done
+// 16 or 32 at a time with SSSE3/AVX2 nibble shuffles. Undecided words
+// (mostly 0x9xxx, 0xAxxx, 0xExxx, 0xFxxx) fall back to u8_decode_inst().
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <r_types.h>
+
+#include "u8_disas.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define U8_CLASSIFY_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*classify_fn)(const ut8 *buf, int nwords, ut8 *type, ut8 *len);
+
+// plain per-word decode - reference, tail handling and undecided words
+static void classify_scalar(const ut8 *buf, int nwords, ut8 *type, ut8 *len)
+{
+	int i;
+
+	for(i=0; i<nwords; i++)
+	{
+		type[i] = u8_decode_inst(r_read_at_le16(buf, i*2));
+		len[i] = u8inst[type[i]].len;
+	}
+}
+
+// redo words the nibble tables left undecided (bit k of 'amb' = word i+k)
+static inline void classify_fixup(const ut8 *buf, int i, unsigned int amb, ut8 *type, ut8 *len)
+{
+	int k;
+
+	while(amb)
+	{
+		k = __builtin_ctz(amb);
+		amb &= amb - 1;
+		type[i+k] = u8_decode_inst(r_read_at_le16(buf, (i+k)*2));
+		len[i+k] = u8inst[type[i+k]].len;
+	}
+}
+
+#ifdef U8_CLASSIFY_X86
+
+// 16 words per iteration
+__attribute__((target("ssse3")))
+static void classify_ssse3(const ut8 *buf, int nwords, ut8 *type, ut8 *len)
+{
+	const __m128i m0f = _mm_set1_epi8(0x0f), m00ff = _mm_set1_epi16(0x00ff);
+	const __m128i one = _mm_set1_epi8(1), two = _mm_set1_epi8(2);
+	const __m128i undecided = _mm_set1_epi8(0xff);
+	const __m128i sel = _mm_loadu_si128((const __m128i *)u8_nib_sel);
+	__m128i ttab[16], ltab[16];
+	__m128i a, b, lo, hi, h, v, s, is1, is2, m, t, l;
+	int i, j;
+
+	for(j=0; j<16; j++)
+	{
+		ttab[j] = _mm_loadu_si128((const __m128i *)u8_nib_type[j]);
+		ltab[j] = _mm_loadu_si128((const __m128i *)u8_nib_len[j]);
+	}
+
+	for(i=0; i+16<=nwords; i+=16)
+	{
+		// split 16 little-endian words into low and high bytes
+		a = _mm_loadu_si128((const __m128i *)(buf + i*2));
+		b = _mm_loadu_si128((const __m128i *)(buf + i*2 + 16));
+		lo = _mm_packus_epi16(_mm_and_si128(a, m00ff), _mm_and_si128(b, m00ff));
+		hi = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+
+		// high nibble, and the nibble u8_nib_sel[] pairs it with
+		h = _mm_and_si128(_mm_srli_epi16(hi, 4), m0f);
+		s = _mm_shuffle_epi8(sel, h);
+		is1 = _mm_cmpeq_epi8(s, one);
+		is2 = _mm_cmpeq_epi8(s, two);
+		v = _mm_or_si128(
+			_mm_or_si128(_mm_and_si128(is1, _mm_and_si128(_mm_srli_epi16(lo, 4), m0f)),
+				_mm_and_si128(is2, _mm_and_si128(hi, m0f))),
+			_mm_andnot_si128(_mm_or_si128(is1, is2), _mm_and_si128(lo, m0f)));
+
+		// one 16-entry shuffle per high nibble row
+		t = l = _mm_setzero_si128();
+		for(j=0; j<16; j++)
+		{
+			m = _mm_cmpeq_epi8(h, _mm_set1_epi8(j));
+			t = _mm_or_si128(t, _mm_and_si128(m, _mm_shuffle_epi8(ttab[j], v)));
+			l = _mm_or_si128(l, _mm_and_si128(m, _mm_shuffle_epi8(ltab[j], v)));
+		}
+
+		_mm_storeu_si128((__m128i *)(type + i), t);
+		_mm_storeu_si128((__m128i *)(len + i), l);
+		classify_fixup(buf, i, _mm_movemask_epi8(_mm_cmpeq_epi8(t, undecided)), type, len);
+	}
+
+	classify_scalar(buf + i*2, nwords - i, type + i, len + i);
+}
+
+// 32 words per iteration; shuffles work per 128-bit lane, so tables are
+// broadcast to both lanes and packed bytes are put back in order
+__attribute__((target("avx2")))
+static void classify_avx2(const ut8 *buf, int nwords, ut8 *type, ut8 *len)
+{
+	const __m256i m0f = _mm256_set1_epi8(0x0f), m00ff = _mm256_set1_epi16(0x00ff);
+	const __m256i one = _mm256_set1_epi8(1), two = _mm256_set1_epi8(2);
+	const __m256i undecided = _mm256_set1_epi8(0xff);
+	const __m256i sel = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)u8_nib_sel));
+	__m256i ttab[16], ltab[16];
+	__m256i a, b, lo, hi, h, v, s, is1, is2, m, t, l;
+	int i, j;
+
+	for(j=0; j<16; j++)
+	{
+		ttab[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)u8_nib_type[j]));
+		ltab[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)u8_nib_len[j]));
+	}
+
+	for(i=0; i+32<=nwords; i+=32)
+	{
+		a = _mm256_loadu_si256((const __m256i *)(buf + i*2));
+		b = _mm256_loadu_si256((const __m256i *)(buf + i*2 + 32));
+		lo = _mm256_packus_epi16(_mm256_and_si256(a, m00ff), _mm256_and_si256(b, m00ff));
+		hi = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+		lo = _mm256_permute4x64_epi64(lo, 0xd8);
+		hi = _mm256_permute4x64_epi64(hi, 0xd8);
+
+		h = _mm256_and_si256(_mm256_srli_epi16(hi, 4), m0f);
+		s = _mm256_shuffle_epi8(sel, h);
+		is1 = _mm256_cmpeq_epi8(s, one);
+		is2 = _mm256_cmpeq_epi8(s, two);
+		v = _mm256_or_si256(
+			_mm256_or_si256(_mm256_and_si256(is1, _mm256_and_si256(_mm256_srli_epi16(lo, 4), m0f)),
+				_mm256_and_si256(is2, _mm256_and_si256(hi, m0f))),
+			_mm256_andnot_si256(_mm256_or_si256(is1, is2), _mm256_and_si256(lo, m0f)));
+
+		t = l = _mm256_setzero_si256();
+		for(j=0; j<16; j++)
+		{
+			m = _mm256_cmpeq_epi8(h, _mm256_set1_epi8(j));
+			t = _mm256_or_si256(t, _mm256_and_si256(m, _mm256_shuffle_epi8(ttab[j], v)));
+			l = _mm256_or_si256(l, _mm256_and_si256(m, _mm256_shuffle_epi8(ltab[j], v)));
+		}
+
+		_mm256_storeu_si256((__m256i *)(type + i), t);
+		_mm256_storeu_si256((__m256i *)(len + i), l);
+		classify_fixup(buf, i, _mm256_movemask_epi8(_mm256_cmpeq_epi8(t, undecided)), type, len);
+	}
+
+	classify_ssse3(buf + i*2, nwords - i, type + i, len + i);
+}
+
+#endif /* U8_CLASSIFY_X86 */
+
+// kernels usable on this CPU, best first
+static int classify_kernels(classify_fn *fn)
+{
+	int n=0;
+
+#ifdef U8_CLASSIFY_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		fn[n++] = classify_avx2;
+	if(__builtin_cpu_supports("ssse3"))
+		fn[n++] = classify_ssse3;
+#endif
+	fn[n++] = classify_scalar;
+
+	return n;
+}
+
+// classify each of 'nwords' words in buf as a first instruction word
+//	type[i], len[i] = u8_decode_inst() of word i and its length in words
+//	words are classified independently - this is not a linear sweep
+void u8_classify(const ut8 *buf, int nwords, ut8 *type, ut8 *len)
+{
+	static classify_fn best;
+	classify_fn fn[3];
+
+	if(!best)
+	{
+		classify_kernels(fn);
+		best = fn[0];
+	}
+	best(buf, nwords, type, len);
+}
+
+// run every available kernel over all 65536 words, at each lane position,
+// and compare with u8_decode_inst()
+//	returns number of mismatching words
+int u8_classify_check(void)
+{
+	classify_fn fn[3];
+	ut8 *buf, *type, *len;
+	int k, nk, rot, i, t, bad=0;
+	const int nwords = 0x10000 + 32;
+	ut16 w;
+
+	buf = malloc(nwords * 2);
+	type = malloc(nwords);
+	len = malloc(nwords);
+	if(!buf || !type || !len)
+	{
+		free(buf);
+		free(type);
+		free(len);
+		return -1;
+	}
+
+	nk = classify_kernels(fn);
+	for(rot=0; rot<32; rot++)
+	{
+		// word w sits at position (w + rot), so every word visits every lane
+		for(i=0; i<nwords; i++)
+		{
+			w = i - rot;
+			buf[i*2] = w;
+			buf[i*2 + 1] = w >> 8;
+		}
+		for(k=0; k<nk; k++)
+		{
+			memset(type, 0, nwords);
+			memset(len, 0, nwords);
+			fn[k](buf, nwords, type, len);
+			for(i=0; i<nwords; i++)
+			{
+				t = u8_decode_inst(r_read_at_le16(buf, i*2));
+				if(type[i] != t || len[i] != u8inst[t].len)
+					bad++;
+			}
+		}
+	}
+
+	free(buf);
+	free(type);
+	free(len);
+	return bad;
+}
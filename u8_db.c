@@ -0,0 +1,279 @@
+/* nX-U8/100 analysis cache file - LGPL - Copyright 2020 - cetus9 */
+
+// Saves what u8_disc and u8_xref found for an image, and maps it back in
+// later: the bitmaps, blocks, block lists and xrefs are used straight from
+// the mapping, only the function array is rebuilt. See u8_db.h for the
+// layout.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <r_types.h>
+
+#include "u8_db.h"
+
+#define DB_ALIGN(n)		(((n) + 7) & ~(ut64)7)
+
+static inline ut64 db_mix(ut64 h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+// 64-bit hash, a word at a time
+ut64 u8_db_hash(const void *buf, size_t len, ut64 seed)
+{
+	const ut8 *p = buf;
+	ut64 h = seed ^ (len * 0x9e3779b97f4a7c15ULL), w;
+	size_t i;
+
+	for(i=0; i+8 <= len; i+=8)
+	{
+		memcpy(&w, p + i, 8);
+		h = (h ^ db_mix(w)) * 0x9e3779b97f4a7c15ULL;
+		h = h << 27 | h >> 37;
+	}
+	w = 0;
+	memcpy(&w, p + i, len - i);
+	return db_mix(h ^ db_mix(w ^ len));
+}
+
+// hash of everything in u8inst[] the decoder uses, field by field so
+// struct padding does not count
+ut64 u8_db_inst_hash(void)
+{
+	const u8inst_t *in;
+	ut8 buf[32];
+	ut64 h = U8_INS_NUM;
+	int i;
+
+	for(i=0; i<U8_INS_NUM; i++)
+	{
+		in = &u8inst[i];
+		memset(buf, 0, sizeof(buf));
+		buf[0] = in->id;
+		buf[1] = in->len;
+		buf[2] = in->ops;
+		buf[3] = in->flags;
+		memcpy(buf + 4, in->name, 6);
+		memcpy(buf + 10, &in->ins, 2);
+		memcpy(buf + 12, &in->ins_mask, 2);
+		memcpy(buf + 14, &in->op1_mask, 2);
+		memcpy(buf + 16, &in->op2_mask, 2);
+		buf[18] = in->op1_shift;
+		buf[19] = in->op2_shift;
+		buf[20] = in->fmt;
+		memcpy(buf + 21, &in->prefix, 2);
+		h = u8_db_hash(buf, sizeof(buf), h);
+	}
+	return h;
+}
+
+// section sizes for a header
+static void db_layout(struct u8_db_hdr *h, ut64 *len)
+{
+	ut64 pos = DB_ALIGN(sizeof(*h));
+	int k;
+
+	len[U8_DB_INSN] = len[U8_DB_BB] = len[U8_DB_FN] = U8_DISC_WORDS / 8;
+	len[U8_DB_BLOCK] = (ut64)h->nblocks * sizeof(struct u8_disc_block);
+	len[U8_DB_FUNC] = (ut64)h->nfuncs * sizeof(struct u8_db_func);
+	len[U8_DB_FBLOCK] = (ut64)h->nfblocks * sizeof(ut32);
+	len[U8_DB_REF] = (ut64)h->nrefs * sizeof(struct u8_xref);
+	len[U8_DB_OFF] = (U8_XREF_SPACE + 1) * sizeof(ut32);
+	for(k=0; k<U8_DB_SECTIONS; k++)
+	{
+		h->sect[k] = pos;
+		pos = DB_ALIGN(pos + len[k]);
+	}
+}
+
+static int db_write(FILE *f, ut64 at, const void *buf, ut64 len)
+{
+	static const ut8 zero[8];
+	long pos = ftell(f);
+
+	// padding up to the section
+	if(pos < 0 || (ut64)pos > at || fwrite(zero, 1, at - pos, f) != at - pos)
+		return -1;
+	return len && fwrite(buf, 1, len, f) != len ? -1 : 0;
+}
+
+// Write the cache for 'd' (and its xrefs 'x') to 'path', through a
+// temporary file renamed into place, so readers never see half a file.
+//	returns 0, or -1 on error
+int u8_db_save(const char *path, const struct u8_disc *d, const struct u8_xrefs *x)
+{
+	struct u8_db_hdr h;
+	struct u8_db_func *func=NULL;
+	ut32 *fblock=NULL, i, n;
+	ut64 len[U8_DB_SECTIONS];
+	char tmp[4096];
+	FILE *f;
+	int error=0;
+
+	if(!x->off || snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid()) >= (int)sizeof(tmp))
+		return -1;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, U8_DB_MAGIC, 4);
+	h.version = U8_DB_VERSION;
+	h.image_hash = u8_db_hash(d->rom, d->size, 0);
+	h.inst_hash = u8_db_inst_hash();
+	h.size = d->size;
+	h.nblocks = d->nblocks;
+	h.nfuncs = d->nfuncs;
+	h.nrefs = x->nrefs;
+	h.ninsn = d->ninsn;
+	for(i=0; i<d->nfuncs; i++)
+		h.nfblocks += d->func[i].nblocks;
+	db_layout(&h, len);
+
+	// functions with their block lists flattened
+	if((d->nfuncs && !(func = malloc(d->nfuncs * sizeof(*func)))) ||
+		(h.nfblocks && !(fblock = malloc(h.nfblocks * sizeof(*fblock)))))
+	{
+		free(func);
+		return -1;
+	}
+	for(i=0, n=0; i<d->nfuncs; i++)
+	{
+		func[i].addr = d->func[i].addr;
+		func[i].size = d->func[i].size;
+		func[i].nblocks = d->func[i].nblocks;
+		func[i].first = n;
+		if(d->func[i].nblocks)
+			memcpy(fblock + n, d->func[i].blocks, d->func[i].nblocks * sizeof(*fblock));
+		n += d->func[i].nblocks;
+	}
+
+	if(!(f = fopen(tmp, "wb")))
+		error = 1;
+	else
+	{
+		error |= fwrite(&h, sizeof(h), 1, f) != 1;
+		error |= db_write(f, h.sect[U8_DB_INSN], d->insn, len[U8_DB_INSN]);
+		error |= db_write(f, h.sect[U8_DB_BB], d->bb, len[U8_DB_BB]);
+		error |= db_write(f, h.sect[U8_DB_FN], d->fn, len[U8_DB_FN]);
+		error |= db_write(f, h.sect[U8_DB_BLOCK], d->block, len[U8_DB_BLOCK]);
+		error |= db_write(f, h.sect[U8_DB_FUNC], func, len[U8_DB_FUNC]);
+		error |= db_write(f, h.sect[U8_DB_FBLOCK], fblock, len[U8_DB_FBLOCK]);
+		error |= db_write(f, h.sect[U8_DB_REF], x->ref, len[U8_DB_REF]);
+		error |= db_write(f, h.sect[U8_DB_OFF], x->off, len[U8_DB_OFF]);
+		error |= fclose(f) != 0;
+		if(!error)
+			error = rename(tmp, path) < 0;
+		if(error)
+			unlink(tmp);
+	}
+	free(func);
+	free(fblock);
+	return error ? -1 : 0;
+}
+
+// Map the cache at 'path' for image 'rom' into 'd' and 'x', which need
+// no u8_disc_init(). They are used as usual and freed with u8_disc_fini()
+// and u8_xref_free(), 'x' before 'd'; u8_disc_run() and u8_disc_update()
+// move the data they change to the heap first.
+//	returns 0, or -1 if there is no valid cache for this image
+int u8_db_load(const char *path, struct u8_disc *d, struct u8_xrefs *x, const ut8 *rom, ut32 size)
+{
+	const struct u8_db_hdr *h;
+	const struct u8_db_func *func;
+	const ut32 *fblock, *off;
+	struct u8_db_hdr lay;
+	struct stat st;
+	ut64 len[U8_DB_SECTIONS];
+	ut8 *map;
+	ut32 i;
+	int fd;
+
+	if(size > U8_DISC_CODE_MAX)
+		size = U8_DISC_CODE_MAX;
+	if((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	if(fstat(fd, &st) < 0 || (ut64)st.st_size < sizeof(*h))
+	{
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+		return -1;
+
+	// header: this image, this decoder, sections where they should be
+	h = (const struct u8_db_hdr *)map;
+	lay = *h;
+	db_layout(&lay, len);
+	if(memcmp(h->magic, U8_DB_MAGIC, 4) || h->version != U8_DB_VERSION || h->size != size ||
+		h->inst_hash != u8_db_inst_hash() || h->image_hash != u8_db_hash(rom, size, 0) ||
+		memcmp(lay.sect, h->sect, sizeof(lay.sect)) ||
+		lay.sect[U8_DB_OFF] + len[U8_DB_OFF] > (ut64)st.st_size)
+		goto fail;
+
+	// indexes, so a damaged file cannot send lookups out of bounds
+	func = (const struct u8_db_func *)(map + h->sect[U8_DB_FUNC]);
+	fblock = (const ut32 *)(map + h->sect[U8_DB_FBLOCK]);
+	off = (const ut32 *)(map + h->sect[U8_DB_OFF]);
+	for(i=0; i<h->nfuncs; i++)
+	{
+		if(func[i].first > h->nfblocks || func[i].nblocks > h->nfblocks - func[i].first)
+			goto fail;
+	}
+	for(i=0; i<h->nfblocks; i++)
+	{
+		if(fblock[i] >= h->nblocks)
+			goto fail;
+	}
+	for(i=0; i<U8_XREF_SPACE; i++)
+	{
+		if(off[i] > off[i+1])
+			goto fail;
+	}
+	if(off[0] || off[U8_XREF_SPACE] > h->nrefs)
+		goto fail;
+
+	memset(d, 0, sizeof(*d));
+	if(h->nfuncs && !(d->func = malloc(h->nfuncs * sizeof(*d->func))))
+		goto fail;
+	for(i=0; i<h->nfuncs; i++)
+	{
+		d->func[i].addr = func[i].addr;
+		d->func[i].size = func[i].size;
+		d->func[i].nblocks = func[i].nblocks;
+		d->func[i].blocks = (ut32 *)(fblock + func[i].first);
+	}
+	d->rom = rom;
+	d->size = size;
+	d->insn = map + h->sect[U8_DB_INSN];
+	d->bb = map + h->sect[U8_DB_BB];
+	d->fn = map + h->sect[U8_DB_FN];
+	d->block = (struct u8_disc_block *)(map + h->sect[U8_DB_BLOCK]);
+	d->nblocks = h->nblocks;
+	d->nfuncs = h->nfuncs;
+	d->ninsn = h->ninsn;
+	d->map = map;
+	d->map_size = st.st_size;
+	d->mapped = 1;
+
+	memset(x, 0, sizeof(*x));
+	x->ref = (struct u8_xref *)(map + h->sect[U8_DB_REF]);
+	x->nrefs = h->nrefs;
+	x->off = (ut32 *)off;
+	x->mapped = 1;
+	return 0;
+
+fail:
+	munmap(map, st.st_size);
+	return -1;
+}
@@ -0,0 +1,64 @@
+/* nX-U8/100 analysis cache file - LGPL - Copyright 2020 - cetus9 */
+
+#ifndef U8_DB_H
+#define U8_DB_H
+
+#include <r_types.h>
+
+#include "u8_disc.h"
+#include "u8_xref.h"
+
+// File: a header, then sections at 8-byte aligned offsets from the start
+// of the file, in host byte order (the version word doubles as an
+// endianness check). No pointers, so a mapping can be used in place:
+//
+//	insn, bb, fn	u8_disc bitmaps, U8_DISC_WORDS / 8 bytes each
+//	block		struct u8_disc_block[nblocks]
+//	func		struct u8_db_func[nfuncs]
+//	fblock		ut32[nfblocks], block indexes of all functions
+//	ref		struct u8_xref[nrefs]
+//	off		ut32[U8_XREF_SPACE + 1]
+//
+// The cache is valid for one image (hash of its bytes and size) and one
+// instruction table (hash of u8inst[]), so decoder changes invalidate it.
+
+#define U8_DB_MAGIC		"U8DB"
+#define U8_DB_VERSION		1
+
+enum
+{
+	U8_DB_INSN, U8_DB_BB, U8_DB_FN, U8_DB_BLOCK, U8_DB_FUNC, U8_DB_FBLOCK,
+	U8_DB_REF, U8_DB_OFF, U8_DB_SECTIONS
+};
+
+struct u8_db_hdr
+{
+	char magic[4];
+	ut32 version;
+	ut64 image_hash;
+	ut64 inst_hash;
+	ut32 size;		// image size
+	ut32 nblocks;
+	ut32 nfuncs;
+	ut32 nfblocks;
+	ut32 nrefs;
+	ut32 pad;
+	ut64 ninsn;
+	ut64 sect[U8_DB_SECTIONS];	// file offsets
+};
+
+// function with its block list as a range of the fblock section
+struct u8_db_func
+{
+	ut32 addr;
+	ut32 size;
+	ut32 nblocks;
+	ut32 first;
+};
+
+ut64 u8_db_hash(const void *buf, size_t len, ut64 seed);
+ut64 u8_db_inst_hash(void);
+int u8_db_save(const char *path, const struct u8_disc *d, const struct u8_xrefs *x);
+int u8_db_load(const char *path, struct u8_disc *d, struct u8_xrefs *x, const ut8 *rom, ut32 size);
+
+#endif /* U8_DB_H */
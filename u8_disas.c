@@ -12,8 +12,59 @@
 // The struct u8inst[U8_INS_NUM] contains instruction definitions
 #include "u8_disas.h"
 
-// operand string format util macro
-#define fmt_op_str(x, args...)	snprintf(cmd->operands, sizeof(cmd->operands), x, ##args)
+// bounded writer for operand strings - hand-rolled, no printf machinery
+struct u8_wr
+{
+	char *p;		// next free char
+	char *end;		// one past last usable char (room for '\0' kept after it)
+	int style;		// U8_STYLE_.. flags
+};
+
+static inline void wr_c(struct u8_wr *w, char c)
+{
+	if(w->p < w->end)
+		*w->p++ = c;
+}
+
+static inline void wr_s(struct u8_wr *w, const char *s)
+{
+	while(*s)
+		wr_c(w, *s++);
+}
+
+// unsigned decimal, as "%d" for operand values
+static inline void wr_dec(struct u8_wr *w, unsigned int v)
+{
+	char tmp[10];
+	int n=0;
+
+	do
+	{
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while(v);
+
+	while(n)
+		wr_c(w, tmp[--n]);
+}
+
+// lowercase hex padded to 'width' with 'pad', as "%x", "%04x" or "%4x"
+static inline void wr_hex(struct u8_wr *w, unsigned int v, int width, char pad)
+{
+	char tmp[8];
+	int n=0;
+
+	do
+	{
+		tmp[n++] = "0123456789abcdef"[v & 0xf];
+		v >>= 4;
+	} while(v);
+
+	while(width-- > n)
+		wr_c(w, pad);
+	while(n)
+		wr_c(w, tmp[--n]);
+}
 
 // for signed 6-bit integers (Disp6)
 int isneg_6bit(ut8 n)
@@ -45,67 +96,22 @@ ut8 abs_7bit(ut8 n)
 		return n & 0x7f;	//	...or just mask out top bit;
 }
 
-// get instruction type (e.g. U8_MOV_..) for given opcode
-int u8_decode_inst(ut16 opcode)
-{
-	ut16 t;
-	int i;
-
-	// iterate through master table of instructions, returning on match
-	// FIXME: this can be done more efficiently
-	for(i=0; i<U8_INS_NUM; i++)
-	{
-		if((opcode & u8inst[i].ins_mask) == u8inst[i].ins)
-   		return i;
-	}
-	// or error
-	return U8_ILL;
-}
+// u8_decode_inst() is generated from u8inst[] at build time (see u8_gen.c,
+// U8_DECODER in Makefile)
 
 // extract operand from first word
 ut16 u8_decode_operand(ut16 inst, ut16 mask)
 {
-	int n;
-
-	// number of bits to shift, based on operand mask
-	// FIXME: remove redundant masks
-	switch(mask)
-	{
-		case 0x0800:
-			n=11; break;
-		case 0x0c00:
-			n=10; break;
-		case 0x0e00:
-			n=9; break;
-		case 0x0f00:
-		case 0x0700:
-			n=8; break;
-		case 0x00e0:
-			n=5; break;
-		case 0x00f0:
-		case 0x0070:
-			n=4; break;
-		case 0x00ff:
-		case 0x007f:
-		case 0x003f:
-		default:
-			n=0;
-	}
-
-	return (inst & mask)>>n;
+	return (inst & mask) >> U8_MASK_SHIFT(mask);
 }
 
-// build opcode string
-int u8_decode_opcode(const ut8 *buf, int len, struct u8_cmd *cmd)
+// decode instruction structure only (type, operands, second word, prefix)
+//	returns instruction length in bytes, or -1 if buffer is too short
+//	inlined into both u8_decode() and the u8_decode_span() loop
+static inline int decode_at(const ut8 *buf, int len, struct u8_cmd *cmd)
 {
-	unsigned int i=0, addr;
-
-	ut16 inst, s_word, prefix=0;
-	ut16 op1, op2;
-
-	// simplify L/ST handling with separate prefix logic
-	ut8 pre_pseg=0, pre_dsr=0, pre_r=0;
-	char prefix_str[8] = "";
+	unsigned int i=0;
+	ut16 inst;
 
 	if(len < 2)			// machine words are at least 2 bytes
 		return -1;
@@ -114,38 +120,24 @@ int u8_decode_opcode(const ut8 *buf, int len, struct u8_cmd *cmd)
 	i++;				// count number of words read
 
 	cmd->type = u8_decode_inst(inst);
+	cmd->prefix = 0;
+	cmd->op1 = cmd->op2 = cmd->s_word = 0;
 
-	switch(cmd->type)
-	{
-		case U8_PRE_PSEG:
-			pre_pseg = u8_decode_operand(inst, u8inst[cmd->type].op1_mask);
-			snprintf(prefix_str, sizeof(prefix_str), "%02xh:", pre_pseg);
-			prefix=inst;
-			break;
-		case U8_PRE_DSR:
-			snprintf(prefix_str, sizeof(prefix_str), "dsr:");
-			pre_dsr=1;
-			prefix=inst;
-			break;
-		case U8_PRE_R:
-			pre_r = u8_decode_operand(inst, u8inst[cmd->type].op1_mask);
-			snprintf(prefix_str, sizeof(prefix_str), "r%d:", pre_r);
-			prefix=inst;
-			break;
-	}
-
-	if(prefix)
+	// DSR prefix for following load/store instruction
+	if(cmd->type == U8_PRE_PSEG || cmd->type == U8_PRE_DSR || cmd->type == U8_PRE_R)
 	{
 		// FIXME: check that instruction after prefix is L/ST 
 		//	otherwise prefix is misidentified
 		if(len < (i+1)*2)			// buffer in bytes
 			return -1;
 
+		cmd->prefix = inst;
 		inst = r_read_at_le16(buf, i*2);	// read first real instruction word after prefix
 		i++;
 
 		cmd->type = u8_decode_inst(inst);
 	}
+	cmd->opcode = inst;
 
 	// if instruction type is 2 words long, read second word
 	if(u8inst[cmd->type].len == 2)
@@ -153,464 +145,310 @@ int u8_decode_opcode(const ut8 *buf, int len, struct u8_cmd *cmd)
 		if(len < (i+1)*2)			// buffer in bytes
 			return -1;
 
-		s_word = r_read_at_le16(buf, i*2);	// read second (possibly third) word from stream
+		cmd->s_word = r_read_at_le16(buf, i*2);	// read second (possibly third) word from stream
 		i++;
 	}
 
-	// set instruction mnemonic
-	strncpy(cmd->instr, u8inst[cmd->type].name, sizeof(cmd->instr));
-
 	// extract first operand from instruction word 1
-	if(u8inst[cmd->type].ops == 1)			// single operand
-	{
-		op1 = u8_decode_operand(inst, u8inst[cmd->type].op1_mask);
-		cmd->op1 = op1;
-	}
-	// ...or extract both operands from instruction word 1
-	if(u8inst[cmd->type].ops == 2)			// 2 operands
+	if(u8inst[cmd->type].ops >= 1)
+		cmd->op1 = (inst & u8inst[cmd->type].op1_mask) >> u8inst[cmd->type].op1_shift;
+
+	// ...and second operand, if any
+	if(u8inst[cmd->type].ops == 2)
+		cmd->op2 = (inst & u8inst[cmd->type].op2_mask) >> u8inst[cmd->type].op2_shift;
+
+	return cmd->len = i*sizeof(inst);	// 1 or 2 words (up to 3 with prefix)
+}
+
+int u8_decode(const ut8 *buf, int len, struct u8_cmd *cmd)
+{
+	return decode_at(buf, len, cmd);
+}
+
+// allocate arrays of a struct u8_block for 'max' instructions
+int u8_block_alloc(struct u8_block *b, int max)
+{
+	b->addr = malloc(max * sizeof(*b->addr));
+	b->type = malloc(max * sizeof(*b->type));
+	b->len = malloc(max * sizeof(*b->len));
+	b->op1 = malloc(max * sizeof(*b->op1));
+	b->op2 = malloc(max * sizeof(*b->op2));
+	b->s_word = malloc(max * sizeof(*b->s_word));
+	b->prefix = malloc(max * sizeof(*b->prefix));
+
+	if(!b->addr || !b->type || !b->len || !b->op1 || !b->op2 || !b->s_word || !b->prefix)
 	{
-		op1 = u8_decode_operand(inst, u8inst[cmd->type].op1_mask);
-		op2 = u8_decode_operand(inst, u8inst[cmd->type].op2_mask);
-		cmd->op1 = op1;
-		cmd->op2 = op2;
+		u8_block_free(b);
+		return -1;
 	}
+	return 0;
+}
 
-	// Display operands with correct formatting
-	switch(cmd->type)
+void u8_block_free(struct u8_block *b)
+{
+	free(b->addr);
+	free(b->type);
+	free(b->len);
+	free(b->op1);
+	free(b->op2);
+	free(b->s_word);
+	free(b->prefix);
+	memset(b, 0, sizeof(*b));
+}
+
+// linear decode of buf from offset 'start' into parallel arrays, while
+// instructions start before offset 'end' (the last may run past it)
+//	returns number of instructions decoded; stops at 'max' instructions
+//	or at the first instruction not fully contained in the buffer
+int u8_decode_span(const ut8 *buf, int len, int start, int end, ut32 base_addr, struct u8_block *out, int max)
+{
+	struct u8_cmd cmd;
+	int n, pos=start, ret;
+
+	for(n=0; n<max && pos<end; n++)
 	{
-		// 8-bit register instructions
-		case U8_ADD_R:
-		case U8_AND_R:
-		case U8_ADDC_R:
-		case U8_CMP_R:
-		case U8_CMPC_R:
-		case U8_MOV_R:
-		case U8_OR_R:
-		case U8_XOR_R:
-		case U8_SUB_R:
-		case U8_SUBC_R:
-		case U8_SLL_R:
-		case U8_SLLC_R:
-		case U8_SRA_R:
-		case U8_SRL_R:
-		case U8_SRLC_R:
-			fmt_op_str("r%d, r%d", op1, op2);
+		ret = decode_at(buf + pos, len - pos, &cmd);
+		if(ret < 0)
 			break;
 
-		// 8-bit register/object instructions
-		case U8_ADD_O:
-		case U8_AND_O:
-		case U8_ADDC_O:
-		case U8_CMP_O:
-		case U8_CMPC_O:
-		case U8_MOV_O:
-		case U8_OR_O:
-		case U8_XOR_O:
-		case U8_SLL_O:
-		case U8_SLLC_O:
-		case U8_SRA_O:
-		case U8_SRL_O:
-		case U8_SRLC_O:
-			fmt_op_str("r%d, #%xh", op1, op2);
-			break;
+		out->addr[n] = base_addr + pos;
+		out->type[n] = cmd.type;
+		out->len[n] = ret;
+		out->op1[n] = cmd.op1;
+		out->op2[n] = cmd.op2;
+		out->s_word[n] = cmd.s_word;
+		out->prefix[n] = cmd.prefix;
 
-		// 16-bit extended register instructions
-		case U8_ADD_ER:
-		case U8_MOV_ER:
-		case U8_CMP_ER:
-			fmt_op_str("er%d, er%d", op1, op2);
-			break;
+		pos += ret;
+	}
 
-		// Extended register/object instructions #imm7
-		case U8_ADD_ER_O:
-		case U8_MOV_ER_O:
-			if(isneg_7bit(op2))
-				fmt_op_str("er%d, #-%xh", op1, abs_7bit(op2));
-			else
-				fmt_op_str("er%d, #%xh", op1, abs_7bit(op2));
-			break;
+	return n;
+}
 
-		// Extended register load/store instructions
-		case U8_L_ER_EA:
-		case U8_ST_ER_EA:
-			fmt_op_str("er%d, %s[ea]", op1, prefix_str);
-			break;
-		case U8_L_ER_EAP:
-		case U8_ST_ER_EAP:
-			fmt_op_str("er%d, %s[ea+]", op1, prefix_str);
-			break;
-		case U8_L_ER_ER:
-		case U8_ST_ER_ER:
-			fmt_op_str("er%d, %s[er%d]", op1, prefix_str, op2);
-			break;
-		case U8_L_ER_D16_ER:
-		case U8_ST_ER_D16_ER:
-			fmt_op_str("er%d, %04xh[er%d]", op1, s_word, op2);
-			break;
-		case U8_L_ER_D6_BP:
-		case U8_ST_ER_D6_BP:
-			if(isneg_6bit(op2))
-				fmt_op_str("er%d, -%xh[bp]", op1, abs_6bit(op2));
-			else
-				fmt_op_str("er%d, %xh[bp]", op1, abs_6bit(op2));
-			break;
-		case U8_L_ER_D6_FP:
-		case U8_ST_ER_D6_FP:
-			if(isneg_6bit(op2))
-				fmt_op_str("er%d, -%xh[fp]", op1, abs_6bit(op2));
-			else
-				fmt_op_str("er%d, %xh[fp]", op1, abs_6bit(op2));
-			break;
-		case U8_L_ER_DA:
-		case U8_ST_ER_DA:
-			fmt_op_str("er%d, %04xh", op1, s_word);
-			break;
+// linear decode of a whole buffer into parallel arrays
+int u8_decode_block(const ut8 *buf, int len, ut32 base_addr, struct u8_block *out, int max)
+{
+	return u8_decode_span(buf, len, 0, len, base_addr, out, max);
+}
 
-		// Register load/store instructions
-		case U8_L_R_EA:
-		case U8_ST_R_EA:
-			fmt_op_str("r%d, [ea]", op1);
-			break;
-		case U8_L_R_EAP:
-		case U8_ST_R_EAP:
-			fmt_op_str("r%d, [ea+]", op1);
-			break;
-		case U8_L_R_ER:
-		case U8_ST_R_ER:
-			fmt_op_str("r%d, [er%d]", op1, op2);
-			break;
-		case U8_L_R_D16_ER:
-		case U8_ST_R_D16_ER:
-			fmt_op_str("r%d, %s%04xh[er%d]", op1, prefix_str, s_word, op2);
-			break;
-		case U8_L_R_D6_BP:
-		case U8_ST_R_D6_BP:
-			if(isneg_6bit(op2))
-				fmt_op_str("r%d, %s-%xh[bp]", op1, prefix_str, abs_6bit(op2));
-			else
-				fmt_op_str("r%d, %s%xh[bp]", op1, prefix_str, abs_6bit(op2));
-			break;
-		case U8_L_R_D6_FP:
-		case U8_ST_R_D6_FP:
-			if(isneg_6bit(op2))
-				fmt_op_str("r%d, %s-%xh[fp]", op1, prefix_str, abs_6bit(op2));
-			else
-				fmt_op_str("r%d, %s%xh[fp]", op1, prefix_str, abs_6bit(op2));
-			break;
-		case U8_L_R_DA:
-		case U8_ST_R_DA:
-			fmt_op_str("r%d, %s%04xh", op1, prefix_str, s_word);
-			break;
+// Control flow of a decoded instruction at code address 'addr' (CSR:PC):
+// where it can go next, as recursive analysis and u8_anop() see it.
+// Relative branches stay in the current segment.
+//	returns U8_FLOW_..; *jump and *fail set to targets where known,
+//	U8_NO_ADDR otherwise
+int u8_flow(const struct u8_cmd *cmd, ut32 addr, ut32 *jump, ut32 *fail)
+{
+	ut32 seg = addr & 0xf0000;
 
-		// Double/quad word register load/store instructions
-		case U8_L_XR_EA:
-		case U8_ST_XR_EA:
-			fmt_op_str("xr%d, %s[ea]", op1, prefix_str);
-			break;
-		case U8_L_XR_EAP:
-		case U8_ST_XR_EAP:
-			fmt_op_str("xr%d, %s[ea+]", op1, prefix_str);
-			break;
-		case U8_L_QR_EA:
-		case U8_ST_QR_EA:
-			fmt_op_str("qr%d, %s[ea]", op1, prefix_str);
-			break;
-		case U8_L_QR_EAP:
-		case U8_ST_QR_EAP:
-			fmt_op_str("qr%d, %s[ea+]", op1, prefix_str);
+	*jump = *fail = U8_NO_ADDR;
+	switch(cmd->type)
+	{
+		case U8_BGE_RAD: case U8_BLT_RAD: case U8_BGT_RAD: case U8_BLE_RAD:
+		case U8_BGES_RAD: case U8_BLTS_RAD: case U8_BGTS_RAD: case U8_BLES_RAD:
+		case U8_BNE_RAD: case U8_BEQ_RAD: case U8_BNV_RAD: case U8_BOV_RAD:
+		case U8_BPS_RAD: case U8_BNS_RAD:
+			// next instruction word, plus op1 words (+ive or -ive)
+			*jump = seg | ((addr + 2 + (st8)cmd->op1 * 2) & 0xffff);
+			*fail = seg | ((addr + 2) & 0xffff);
+			return U8_FLOW_CJMP;
+		case U8_BAL_RAD:
+			*jump = seg | ((addr + 2 + (st8)cmd->op1 * 2) & 0xffff);
+			return U8_FLOW_JMP;
+		case U8_B_AD:
+			*jump = ((ut32)cmd->op1 << 16) | cmd->s_word;
+			return U8_FLOW_JMP;
+		case U8_BL_AD:
+			*jump = ((ut32)cmd->op1 << 16) | cmd->s_word;
+			*fail = seg | ((addr + cmd->len) & 0xffff);
+			return U8_FLOW_CALL;
+		case U8_B_ER:
+			return U8_FLOW_IJMP;
+		case U8_BL_ER:
+			*fail = seg | ((addr + cmd->len) & 0xffff);
+			return U8_FLOW_RCALL;
+		case U8_SWI_O:
+			*jump = 0x80 + cmd->op1 * 2;	// vector, not the handler
+			*fail = seg | ((addr + cmd->len) & 0xffff);
+			return U8_FLOW_SWI;
+		case U8_RT: case U8_RTI:
+			return U8_FLOW_RET;
+		case U8_POP_RL:
+			if(cmd->op1 & 2)		// pop pc
+				return U8_FLOW_RET;
 			break;
+		case U8_BRK: case U8_ILL:
+		case U8_PRE_PSEG: case U8_PRE_DSR: case U8_PRE_R:
+			return U8_FLOW_STOP;
+	}
+	*fail = seg | ((addr + cmd->len) & 0xffff);
+	return U8_FLOW_NEXT;
+}
 
-		// Control register access instructions
-		case U8_ADD_SP_O:
-			fmt_op_str("sp, #%xh", op1);
-			break;
-		case U8_MOV_ECSR_R:
-			fmt_op_str("ecsr, r%d", op1);
-			break;
-		case U8_MOV_ELR_ER:
-			fmt_op_str("elr, er%d", op1);
-			break;
-		case U8_MOV_EPSW_R:
-			fmt_op_str("epsw, r%d", op1);
-			break;
-		case U8_MOV_ER_ELR:
-			fmt_op_str("er%d, elr", op1);
-			break;
-		case U8_MOV_ER_SP:
-			fmt_op_str("er%d, sp", op1);
-			break;
-		case U8_MOV_PSW_R:
-			fmt_op_str("psw, r%d", op1);
-			break;
-		case U8_MOV_PSW_O:
-			fmt_op_str("psw, #%xh", op1);
-			break;
-		case U8_MOV_R_ECSR:
-			fmt_op_str("r%d, ecsr", op1);
-			break;
-		case U8_MOV_R_EPSW:
-			fmt_op_str("r%d, epsw", op1);
-			break;
-		case U8_MOV_R_PSW:
-			fmt_op_str("r%d, psw", op1);
-			break;
-		case U8_MOV_SP_ER:
-			fmt_op_str("sp, er%d", op1);
-			break;
+// number in the selected hex style: "1fh" (default) or "0x1f" (U8_STYLE_CHEX)
+static inline void wr_num(struct u8_wr *w, unsigned int v, int width, char pad)
+{
+	if(w->style & U8_STYLE_CHEX)
+	{
+		wr_s(w, "0x");
+		wr_hex(w, v, width, '0');
+	}
+	else
+	{
+		wr_hex(w, v, width, pad);
+		wr_c(w, 'h');
+	}
+}
 
-		// Push/pop instructions
-		case U8_PUSH_ER:
-		case U8_POP_ER:
-			fmt_op_str("er%d", op1);
-			break;
-		case U8_PUSH_QR:
-		case U8_POP_QR:
-			fmt_op_str("qr%d", op1);
+// DSR prefix of a load/store operand, e.g. "dsr:", "r2:", "03h:"
+static void wr_prefix(struct u8_wr *w, ut16 prefix)
+{
+	switch(prefix ? u8_decode_inst(prefix) : U8_ILL)
+	{
+		case U8_PRE_PSEG:
+			wr_num(w, (prefix & u8inst[U8_PRE_PSEG].op1_mask) >> u8inst[U8_PRE_PSEG].op1_shift, 2, '0');
+			wr_c(w, ':');
 			break;
-		case U8_PUSH_R:
-		case U8_POP_R:
-			fmt_op_str("r%d", op1);
+		case U8_PRE_DSR:
+			wr_s(w, "dsr:");
 			break;
-		case U8_PUSH_XR:
-		case U8_POP_XR:
-			fmt_op_str("xr%d", op1);
+		case U8_PRE_R:
+			wr_c(w, 'r');
+			wr_dec(w, (prefix & u8inst[U8_PRE_R].op1_mask) >> u8inst[U8_PRE_R].op1_shift);
+			wr_c(w, ':');
 			break;
+	}
+}
 
-		// Register list stack instructions
-		case U8_PUSH_RL:
-			switch(op1)			// parse 4-bit list
-			{
-				case 1:
-					fmt_op_str("ea"); break;
-				case 2:
-					fmt_op_str("elr"); break;
-				case 3:
-					fmt_op_str("ea, elr"); break;
-				case 4:
-					fmt_op_str("epsw"); break;
-				case 5:
-					fmt_op_str("epsw, ea"); break;
-				case 6:
-					fmt_op_str("epsw, elr"); break;
-				case 7:
-					fmt_op_str("epsw, elr, ea"); break;
-				case 8:
-					fmt_op_str("lr"); break;
-				case 9:
-					fmt_op_str("lr, ea"); break;
-				case 0xa:
-					fmt_op_str("lr, elr"); break;
-				case 0xb:
-					fmt_op_str("lr, ea, elr"); break;
-				case 0xc:
-					fmt_op_str("lr, epsw"); break;
-				case 0xd:
-					fmt_op_str("lr, epsw, ea"); break;
-				case 0xe:
-					fmt_op_str("lr, epsw, elr"); break;
-				case 0xf:
-					fmt_op_str("lr, epsw, elr, ea"); break;
-				default:
-					fmt_op_str("?");
-			}
-			break;
+// write operands of a decoded instruction, as given by the format
+// descriptor of its operand class (u8_fmt_desc[] in u8_inst.c)
+static void wr_operands(struct u8_wr *w, const struct u8_cmd *cmd)
+{
+	const char *d = u8_fmt_desc[u8inst[cmd->type].fmt];
+	ut16 op1 = cmd->op1, op2 = cmd->op2;
 
-		case U8_POP_RL:
-			switch(op1)			// parse 4-bit list
-			{
-				case 1:
-					fmt_op_str("ea"); break;
-				case 2:
-					fmt_op_str("pc"); break;
-				case 3:
-					fmt_op_str("ea, pc"); break;
-				case 4:
-					fmt_op_str("psw"); break;
-				case 5:
-					fmt_op_str("ea, psw"); break;
-				case 6:
-					fmt_op_str("pc, psw"); break;
-				case 7:
-					fmt_op_str("ea, pc, psw"); break;
-				case 8:
-					fmt_op_str("lr"); break;
-				case 9:
-					fmt_op_str("ea, lr"); break;
-				case 0xa:
-					fmt_op_str("pc, lr"); break;
-				case 0xb:
-					fmt_op_str("ea, pc, lr"); break;
-				case 0xc:
-					fmt_op_str("lr, psw"); break;
-				case 0xd:
-					fmt_op_str("ea, psw, lr"); break;
-				case 0xe:
-					fmt_op_str("pc, psw, lr"); break;
-				case 0xf:
-					fmt_op_str("ea, pc, psw, lr"); break;
-				default:
-					fmt_op_str("?");
-			}
-			break;
+	for(; *d; d++)
+	{
+		if(*d != '%')
+		{
+			wr_c(w, *d);
+			continue;
+		}
+
+		switch(*++d)
+		{
+			case '1':		// register number, op1
+				wr_dec(w, op1); break;
+			case '2':		// register number / bit, op2
+				wr_dec(w, op2); break;
+			case 'x':		// hex immediate, op1
+				wr_num(w, op1, 0, 0); break;
+			case 'X':		// hex immediate, op2
+				wr_num(w, op2, 0, 0); break;
+			case '7':		// signed #imm7, op2
+				if(isneg_7bit(op2))
+					wr_c(w, '-');
+				wr_num(w, abs_7bit(op2), 0, 0);
+				break;
+			case '6':		// signed Disp6, op2
+				if(isneg_6bit(op2))
+					wr_c(w, '-');
+				wr_num(w, abs_6bit(op2), 0, 0);
+				break;
+			case 'w':		// second word, Disp16/Dadr
+				wr_num(w, cmd->s_word, 4, '0'); break;
+			case 'r':		// relative branch, signed words
+				if((st8)op1 < 0)
+				{
+					wr_c(w, '-');
+					wr_num(w, abs(0-(st8)op1), 2, '0');
+				}
+				else
+				{
+					wr_c(w, '+');
+					wr_num(w, (st8)op1, 2, '0');
+				}
+				break;
+			case 'p':		// DSR prefix slot
+				wr_prefix(w, cmd->prefix); break;
+			case 'l':		// push register list, op1
+				wr_s(w, u8_push_list[op1 & 0xf]); break;
+			case 'L':		// pop register list, op1
+				wr_s(w, u8_pop_list[op1 & 0xf]); break;
+			case 'i':		// raw instruction word ('dw')
+				wr_num(w, cmd->opcode, 4, ' '); break;
+			default:		// bad descriptor
+				return;
+		}
+	}
+}
 
-		// Coprocessor data transfer instructions
-		case U8_MOV_CR_R:
-			fmt_op_str("cr%d, r%d", op1, op2);
-			break;
-		case U8_MOV_CER_EA:
-			fmt_op_str("cer%d, [ea]", op1);
-			break;
-		case U8_MOV_CER_EAP:
-			fmt_op_str("cer%d, [ea+]", op1);
-			break;
-		case U8_MOV_CR_EA:
-			fmt_op_str("cr%d, [ea]", op1);
-			break;
-		case U8_MOV_CR_EAP:
-			fmt_op_str("cr%d, [ea+]", op1);
-			break;
-		case U8_MOV_CXR_EA:
-			fmt_op_str("cxr%d, [ea]", op1);
-			break;
-		case U8_MOV_CXR_EAP:
-			fmt_op_str("cxr%d, [ea+]", op1);
-			break;
-		case U8_MOV_CQR_EA:
-			fmt_op_str("cqr%d, [ea]", op1);
-			break;
-		case U8_MOV_CQR_EAP:
-			fmt_op_str("cqr%d, [ea+]", op1);
-			break;
-		case U8_MOV_R_CR:
-			fmt_op_str("r%d, cr%d", op1, op2);
-			break;
-		case U8_MOV_EA_CER:
-			fmt_op_str("[ea], cer%d", op1);
-			break;
-		case U8_MOV_EAP_CER:
-			fmt_op_str("[ea+], cer%d", op1);
-			break;
-		case U8_MOV_EA_CR:
-			fmt_op_str("[ea], cr%d", op1);
-			break;
-		case U8_MOV_EAP_CR:
-			fmt_op_str("[ea+], cr%d", op1);
-			break;
-		case U8_MOV_EA_CXR:
-			fmt_op_str("[ea], cxr%d", op1);
-			break;
-		case U8_MOV_EAP_CXR:
-			fmt_op_str("[ea+], cxr%d", op1);
-			break;
-		case U8_MOV_EA_CQR:
-			fmt_op_str("[ea], cqr%d", op1);
-			break;
-		case U8_MOV_EAP_CQR:
-			fmt_op_str("[ea+], cqr%d", op1);
-			break;
+// uppercase a rendered string in place (U8_STYLE_UPPER), keeping "0x"
+static void str_upper(char *p, char *end)
+{
+	char *start = p;
 
-		// EA register data transfer instructions
-		case U8_LEA_ER:
-			fmt_op_str("[er%d]", op1);
-			break;
-		case U8_LEA_D16_ER:
-			fmt_op_str("%04xh[er%d]", s_word, op1);
-			break;
-		case U8_LEA_DA:
-			fmt_op_str("%04xh", s_word);
-			break;
+	for(; p < end; p++)
+	{
+		if(*p == 'x' && p > start && p[-1] == '0')
+			continue;
+		if(*p >= 'a' && *p <= 'z')
+			*p -= 'a' - 'A';
+	}
+}
 
-		// ALU Instructions
-		case U8_DAA_R:
-		case U8_DAS_R:
-		case U8_NEG_R:
-			fmt_op_str("r%d", op1);
-			break;
+// build mnemonic and operand strings for a decoded instruction
+void u8_format(struct u8_cmd *cmd)
+{
+	struct u8_wr w = {cmd->operands, cmd->operands + sizeof(cmd->operands) - 1, 0};
 
-		// Bit access instructions
-		case U8_SB_R:
-		case U8_RB_R:
-		case U8_TB_R:
-			fmt_op_str("r%d.%d", op1, op2);
-			break;
-		case U8_SB_DBIT:
-		case U8_RB_DBIT:
-		case U8_TB_DBIT:
-			fmt_op_str("%04xh.%d", s_word, op1);
-			break;
+	// set instruction mnemonic
+	strncpy(cmd->instr, u8inst[cmd->type].name, sizeof(cmd->instr));
 
-		// PSW access instructions (no operands)
-		case U8_EI:
-		case U8_DI:
-		case U8_SC:
-		case U8_RC:
-		case U8_CPLC:
-			break;
+	wr_operands(&w, cmd);
+	*w.p = '\0';
+}
 
-		// Conditional relative branch instructions
-		case U8_BGE_RAD:
-		case U8_BLT_RAD:
-		case U8_BGT_RAD:
-		case U8_BLE_RAD:
-		case U8_BGES_RAD:
-		case U8_BLTS_RAD:
-		case U8_BGTS_RAD:
-		case U8_BLES_RAD:
-		case U8_BNE_RAD:
-		case U8_BEQ_RAD:
-		case U8_BNV_RAD:
-		case U8_BOV_RAD:
-		case U8_BPS_RAD:
-		case U8_BNS_RAD:
-		case U8_BAL_RAD:
-			// handle +ive or -ive address jump cases
-			if((st8)op1 < 0)
-				fmt_op_str("-%02xh", abs(0-(st8)op1));
-			else
-				fmt_op_str("+%02xh", (st8)op1);
-			break;
+// write "mnemonic operands" for a decoded instruction straight into buf,
+// in the given output style (U8_STYLE_..)
+//	returns length written, excluding '\0'
+int u8_format_style(const struct u8_cmd *cmd, char *buf, int size, int style)
+{
+	struct u8_wr w = {buf, buf + size - 1, style};
+	char *ops_end;
 
-		// Sign extension instruction
-		case U8_EXTBW_ER:
-			fmt_op_str("er%d", op2);
-			break;
+	if(size < 1)
+		return 0;
 
-		// Software interrupt instructions
-		case U8_SWI_O:
-			fmt_op_str("#%xh", op1);
-			break;
-		case U8_BRK:
-			break;
+	wr_s(&w, (const char *)u8inst[cmd->type].name);
+	wr_c(&w, ' ');
 
-		// Branch instructions
-		case U8_B_AD:
-		case U8_BL_AD:
-			fmt_op_str("%xh:%04xh", op1, s_word);
-			break;
-		case U8_B_ER:
-		case U8_BL_ER:
-			fmt_op_str("er%d", op1);
-			break;
+	// operands are cut at the same length as in struct u8_cmd
+	ops_end = w.end;
+	if(w.end - w.p > sizeof(cmd->operands) - 1)
+		w.end = w.p + sizeof(cmd->operands) - 1;
+	wr_operands(&w, cmd);
+	w.end = ops_end;
 
-		// Multiplication and division instructions
-		case U8_MUL_ER:
-		case U8_DIV_ER:
-			fmt_op_str("er%d, r%d", op1, op2);
-			break;
+	if(style & U8_STYLE_UPPER)
+		str_upper(buf, w.p);
 
-		// Miscellaneous (no operands)
-		case U8_INC_EA:
-		case U8_DEC_EA:
-		case U8_RT:
-		case U8_RTI:
-		case U8_NOP:
-			break;
+	*w.p = '\0';
+	return w.p - buf;
+}
 
-		case U8_ILL:
-		default:
-			// will display with 'dw' mnemonic to indicate 'data'
-			fmt_op_str("%4xh", inst);
-	}
+// same text as u8_format() joined with a space, without the copies
+int u8_format_asm(const struct u8_cmd *cmd, char *buf, int size)
+{
+	return u8_format_style(cmd, buf, size, 0);
+}
+
+// decode and format instruction
+int u8_decode_opcode(const ut8 *buf, int len, struct u8_cmd *cmd)
+{
+	int ret = u8_decode(buf, len, cmd);
+
+	if(ret > 0)
+		u8_format(cmd);
 
-	return i*sizeof(inst);		// 1 or 2 words (up to 3 with prefix)
+	return ret;
 }
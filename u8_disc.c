@@ -0,0 +1,1033 @@
+/* nX-U8/100 recursive code discovery - LGPL - Copyright 2020 - cetus9 */
+
+// Finds code by following control flow from a set of roots (the reset and
+// interrupt vectors), rather than asking r2 to analyse one function at a
+// time through u8_anop().
+//
+// Phase 1 walks the code. Work items are code addresses, bit 31 set for
+// function entries. A walk decodes forward from its address, queues branch
+// and call targets, and stops at a return, an unconditional branch or the
+// first instruction some other walk has already decoded. Decoded words,
+// block starts and function entries are bits in three bitmaps covering all
+// 16 segments, set with atomic or, so walks never decode the same word
+// twice. Each thread has its own stack of items; a thread that runs dry
+// takes the bottom half of another thread's stack.
+//
+// Phase 2 cuts the decoded code into basic blocks at the block start bits,
+// in address order. Phase 3 gathers each function's blocks by following
+// block successors from its entry, one function per job, in parallel.
+//
+// The bitmaps are the same whatever order the walks ran in, so results do
+// not depend on the number of threads.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <r_types.h>
+
+#include "u8_disc.h"
+
+#define DISC_FN			0x80000000	// work item is a function entry
+#define DISC_STEAL_MAX		256
+
+struct disc_worker
+{
+	pthread_mutex_t lock;
+	ut32 *item;			// owner pushes and pops at the top,
+	int n, max;			// thieves take from the bottom
+	ut32 *mark;			// phase 3: function that last visited a block
+	ut32 *stack;
+	struct disc_run *run;
+	int index;
+	pthread_t thread;
+	int threaded;
+	int error;
+} __attribute__((aligned(64)));
+
+struct disc_run
+{
+	struct u8_disc *d;
+	struct disc_worker *w;
+	int nworkers;
+	int pending;			// items queued and not yet walked
+	ut32 next_func;			// phase 3: next function to gather
+
+	// u8_disc_update(), one worker: addresses that gained a bit
+	int track;
+	ut32 *changed;
+	ut32 nchanged, max_changed;
+	int error;
+};
+
+static inline int bit_test(const ut8 *map, ut32 addr)
+{
+	ut32 w = addr >> 1;
+
+	return (__atomic_load_n(&map[w >> 3], __ATOMIC_RELAXED) >> (w & 7)) & 1;
+}
+
+// returns the old bit
+static inline int bit_set(ut8 *map, ut32 addr)
+{
+	ut32 w = addr >> 1;
+	ut8 m = 1 << (w & 7);
+
+	return (__atomic_fetch_or(&map[w >> 3], m, __ATOMIC_RELAXED) & m) != 0;
+}
+
+// bit_set() for walks, noting new bits when tracking
+static inline int disc_mark(struct disc_worker *w, ut8 *map, ut32 addr)
+{
+	struct disc_run *run = w->run;
+	ut32 *p;
+
+	if(bit_set(map, addr))
+		return 1;
+	if(run->track)
+	{
+		if(run->nchanged == run->max_changed)
+		{
+			run->max_changed = run->max_changed ? run->max_changed * 2 : 256;
+			if(!(p = realloc(run->changed, run->max_changed * sizeof(*p))))
+			{
+				run->error = 1;
+				return 0;
+			}
+			run->changed = p;
+		}
+		run->changed[run->nchanged++] = addr;
+	}
+	return 0;
+}
+
+int u8_disc_init(struct u8_disc *d, const ut8 *rom, ut32 size)
+{
+	memset(d, 0, sizeof(*d));
+	if(size > U8_DISC_CODE_MAX)
+		size = U8_DISC_CODE_MAX;
+	d->rom = rom;
+	d->size = size;
+	d->insn = calloc(U8_DISC_WORDS / 8, 1);
+	d->bb = calloc(U8_DISC_WORDS / 8, 1);
+	d->fn = calloc(U8_DISC_WORDS / 8, 1);
+	if(!d->insn || !d->bb || !d->fn)
+	{
+		u8_disc_fini(d);
+		return -1;
+	}
+	return 0;
+}
+
+// blocks and functions; with a mapped cache file (u8_db_load()) the blocks
+// and function block lists live in the mapping
+static void disc_free_results(struct u8_disc *d)
+{
+	ut32 i;
+
+	if(!d->mapped)
+	{
+		for(i=0; i<d->nfuncs; i++)
+			free(d->func[i].blocks);
+		free(d->block);
+	}
+	free(d->func);
+	d->func = NULL;
+	d->block = NULL;
+	d->nfuncs = d->nblocks = 0;
+}
+
+// move everything a mapped cache file holds to the heap, before it is
+// changed; the mapping itself stays for the xrefs
+static int disc_to_heap(struct u8_disc *d)
+{
+	struct u8_disc_block *block=NULL;
+	ut32 **blocks=NULL, i, n=0;
+	ut8 *map[3] = { NULL, NULL, NULL };
+	int k, error=0;
+
+	for(k=0; k<3; k++)
+		error |= !(map[k] = malloc(U8_DISC_WORDS / 8));
+	if(d->nblocks)
+		error |= !(block = malloc(d->nblocks * sizeof(*block)));
+	if(d->nfuncs)
+		error |= !(blocks = malloc(d->nfuncs * sizeof(*blocks)));
+	for(n=0; !error && n<d->nfuncs; n++)
+		error |= !(blocks[n] = malloc((d->func[n].nblocks + 1) * sizeof(**blocks)));
+	if(error)
+	{
+		while(n--)
+			free(blocks[n]);
+		free(blocks);
+		free(block);
+		for(k=0; k<3; k++)
+			free(map[k]);
+		return -1;
+	}
+
+	memcpy(map[0], d->insn, U8_DISC_WORDS / 8);
+	memcpy(map[1], d->bb, U8_DISC_WORDS / 8);
+	memcpy(map[2], d->fn, U8_DISC_WORDS / 8);
+	memcpy(block, d->block, d->nblocks * sizeof(*block));
+	for(i=0; i<d->nfuncs; i++)
+	{
+		memcpy(blocks[i], d->func[i].blocks, d->func[i].nblocks * sizeof(**blocks));
+		d->func[i].blocks = blocks[i];
+	}
+	free(blocks);
+	d->mapped = 0;
+	d->insn = map[0];
+	d->bb = map[1];
+	d->fn = map[2];
+	d->block = block;
+	return 0;
+}
+
+void u8_disc_fini(struct u8_disc *d)
+{
+	disc_free_results(d);
+	free(d->dirty);
+	if(d->map)
+		munmap(d->map, d->map_size);
+	if(!d->mapped)
+	{
+		free(d->insn);
+		free(d->bb);
+		free(d->fn);
+	}
+	memset(d, 0, sizeof(*d));
+}
+
+// Handler address in the vector table entry at 'addr': unprogrammed
+// (ffffh), odd entries and ones pointing back into the table or past the
+// image are not code.
+//	returns U8_NO_ADDR if not code
+ut32 u8_vector_target(const ut8 *rom, ut32 size, ut32 addr)
+{
+	ut32 target;
+
+	if(addr + 1 >= size)
+		return U8_NO_ADDR;
+	target = rom[addr] | rom[addr+1] << 8;
+	if(target & 1 || target < U8_VECTORS * 2 || target >= size)
+		return U8_NO_ADDR;
+	return target;
+}
+
+// Read the whole vector table: initial SP (00h), reset (02h), brk (04h),
+// NMI (08h), maskable interrupts (06h, 0ah..7eh) and the 64 swi vectors
+// (80h..feh).
+//	returns the number of entries, U8_VECTORS unless the image is smaller
+int u8_vectors(const ut8 *rom, ut32 size, struct u8_vector *vec)
+{
+	struct u8_vector *v;
+	ut32 addr;
+	int n=0;
+
+	for(addr=0; addr < U8_VECTORS * 2 && addr + 1 < size; addr+=2, n++)
+	{
+		v = &vec[n];
+		v->addr = addr;
+		v->target = u8_vector_target(rom, size, addr);
+		if(addr == 0)
+		{
+			v->kind = U8_VEC_SP;
+			v->target = rom[0] | rom[1] << 8;
+			strcpy(v->name, "sp");
+		}
+		else if(addr == 0x02)
+		{
+			v->kind = U8_VEC_RESET;
+			strcpy(v->name, "reset");
+		}
+		else if(addr == 0x04)
+		{
+			v->kind = U8_VEC_BRK;
+			strcpy(v->name, "brk");
+		}
+		else if(addr == 0x08)
+		{
+			v->kind = U8_VEC_NMI;
+			strcpy(v->name, "nmi");
+		}
+		else if(addr < U8_VEC_SWI_BASE)
+		{
+			v->kind = U8_VEC_INT;
+			snprintf(v->name, sizeof(v->name), "int_%02x", addr);
+		}
+		else
+		{
+			v->kind = U8_VEC_SWI;
+			snprintf(v->name, sizeof(v->name), "swi_%d", (addr - U8_VEC_SWI_BASE) / 2);
+		}
+	}
+	return n;
+}
+
+// Code roots from the vector table: every programmed handler, once each
+// (unused vectors often share a default handler).
+//	returns the number of roots written
+int u8_disc_vectors(const ut8 *rom, ut32 size, ut32 *roots, int max)
+{
+	struct u8_vector vec[U8_VECTORS];
+	int i, j, nvec, n=0;
+
+	nvec = u8_vectors(rom, size, vec);
+	for(i=0; i<nvec && n < max; i++)
+	{
+		if(vec[i].kind == U8_VEC_SP || vec[i].target == U8_NO_ADDR)
+			continue;
+		for(j=0; j<n && roots[j] != vec[i].target; j++)
+			;
+		if(j == n)
+			roots[n++] = vec[i].target;
+	}
+	return n;
+}
+
+// queue an item on our own stack
+static void disc_push(struct disc_worker *w, ut32 item)
+{
+	struct u8_disc *d = w->run->d;
+	ut32 addr = item & ~DISC_FN, *p;
+
+	// already walked: only the marks are missing
+	if(bit_test(d->insn, addr))
+	{
+		if(item & DISC_FN)
+			disc_mark(w, d->fn, addr);
+		disc_mark(w, d->bb, addr);
+		return;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	if(w->n == w->max)
+	{
+		if(!(p = realloc(w->item, (w->max ? w->max * 2 : 1024) * sizeof(*p))))
+		{
+			pthread_mutex_unlock(&w->lock);
+			w->error = 1;
+			return;
+		}
+		w->item = p;
+		w->max = w->max ? w->max * 2 : 1024;
+	}
+	__atomic_add_fetch(&w->run->pending, 1, __ATOMIC_RELAXED);
+	w->item[w->n++] = item;
+	pthread_mutex_unlock(&w->lock);
+}
+
+static int disc_pop(struct disc_worker *w, ut32 *item)
+{
+	int ret=0;
+
+	pthread_mutex_lock(&w->lock);
+	if(w->n)
+	{
+		*item = w->item[--w->n];
+		ret = 1;
+	}
+	pthread_mutex_unlock(&w->lock);
+	return ret;
+}
+
+// take the bottom half of another worker's stack; the first item is
+// returned, the rest go on ours
+static int disc_steal(struct disc_worker *w, ut32 *item)
+{
+	struct disc_run *run = w->run;
+	struct disc_worker *v;
+	ut32 buf[DISC_STEAL_MAX];
+	int k, i, take=0;
+
+	for(k=1; k<run->nworkers && !take; k++)
+	{
+		v = &run->w[(w->index + k) % run->nworkers];
+		pthread_mutex_lock(&v->lock);
+		if(v->n)
+		{
+			take = (v->n + 1) / 2;
+			if(take > DISC_STEAL_MAX)
+				take = DISC_STEAL_MAX;
+			memcpy(buf, v->item, take * sizeof(*buf));
+			memmove(v->item, v->item + take, (v->n - take) * sizeof(*buf));
+			v->n -= take;
+		}
+		pthread_mutex_unlock(&v->lock);
+	}
+	if(!take)
+		return 0;
+
+	*item = buf[0];
+	if(take > 1)
+	{
+		pthread_mutex_lock(&w->lock);
+		if(w->max - w->n < take - 1)
+		{
+			ut32 *p = realloc(w->item, (w->n + take + 1024) * sizeof(*p));
+
+			if(!p)
+			{
+				pthread_mutex_unlock(&w->lock);
+				__atomic_sub_fetch(&run->pending, take - 1, __ATOMIC_RELAXED);
+				w->error = 1;
+				return 1;
+			}
+			w->item = p;
+			w->max = w->n + take + 1024;
+		}
+		for(i=1; i<take; i++)
+			w->item[w->n++] = buf[i];
+		pthread_mutex_unlock(&w->lock);
+	}
+	return 1;
+}
+
+// decode forward from one item, queueing what it branches to
+static void disc_walk(struct disc_worker *w, ut32 item)
+{
+	struct u8_disc *d = w->run->d;
+	struct u8_cmd cmd;
+	ut32 addr = item & ~DISC_FN, jump, fail;
+
+	if(addr & 1 || addr >= d->size)
+		return;
+	if(item & DISC_FN)
+		disc_mark(w, d->fn, addr);
+	disc_mark(w, d->bb, addr);
+
+	for(;;)
+	{
+		if(addr >= d->size || u8_decode(d->rom + addr, d->size - addr, &cmd) < 0)
+			return;
+		if(disc_mark(w, d->insn, addr))
+		{
+			// ran into code another walk decoded: a block starts here
+			disc_mark(w, d->bb, addr);
+			return;
+		}
+
+		switch(u8_flow(&cmd, addr, &jump, &fail))
+		{
+			case U8_FLOW_CALL:
+				if(!(jump & 1) && jump < d->size)
+					disc_push(w, jump | DISC_FN);
+				break;
+			case U8_FLOW_CJMP:
+				disc_push(w, jump);
+				disc_mark(w, d->bb, fail);
+				break;
+			case U8_FLOW_JMP:
+				if(!(jump & 1) && jump < d->size)
+					disc_push(w, jump);
+				return;
+			case U8_FLOW_SWI:
+				if((jump = u8_vector_target(d->rom, d->size, jump)) != U8_NO_ADDR)
+					disc_push(w, jump | DISC_FN);
+				break;
+			case U8_FLOW_NEXT: case U8_FLOW_RCALL:
+				break;
+			default:
+				return;
+		}
+		addr = fail;
+	}
+}
+
+static void *disc_worker(void *arg)
+{
+	struct disc_worker *w = arg;
+	ut32 item;
+
+	for(;;)
+	{
+		if(disc_pop(w, &item) || disc_steal(w, &item))
+		{
+			disc_walk(w, item);
+			__atomic_sub_fetch(&w->run->pending, 1, __ATOMIC_RELEASE);
+		}
+		else if(!__atomic_load_n(&w->run->pending, __ATOMIC_ACQUIRE))
+			break;
+		else
+			sched_yield();
+	}
+	return NULL;
+}
+
+// one block from 'addr', which has its block start and instruction bits
+static void disc_cut(const struct u8_disc *d, ut32 addr, struct u8_disc_block *b)
+{
+	struct u8_cmd cmd;
+	ut32 jump, fail;
+	int end;
+
+	b->addr = addr;
+	b->size = 0;
+	b->ninsn = 0;
+	b->jump = b->fail = U8_NO_ADDR;
+	for(end=0; !end; )
+	{
+		u8_decode(d->rom + addr, d->size - addr, &cmd);
+		b->size += cmd.len;
+		b->ninsn++;
+		switch(u8_flow(&cmd, addr, &jump, &fail))
+		{
+			case U8_FLOW_CJMP:
+				b->jump = jump;
+				b->fail = fail;
+				end = 1;
+				break;
+			case U8_FLOW_JMP:
+				b->jump = jump;
+				end = 1;
+				break;
+			case U8_FLOW_NEXT: case U8_FLOW_CALL: case U8_FLOW_RCALL: case U8_FLOW_SWI:
+				if(fail >= d->size || !bit_test(d->insn, fail))
+					end = 1;
+				else if(bit_test(d->bb, fail))
+				{
+					b->jump = fail;
+					end = 1;
+				}
+				addr = fail;
+				break;
+			default:
+				end = 1;
+		}
+	}
+}
+
+// cut the decoded code into blocks, in address order
+static int disc_blocks(struct u8_disc *d)
+{
+	ut32 i, n=0, addr, words = (d->size + 1) / 2;
+
+	for(i=0; i<(words + 7) / 8; i++)
+		n += __builtin_popcount(d->bb[i] & d->insn[i]);
+	if(n && !(d->block = malloc(n * sizeof(*d->block))))
+		return -1;
+
+	d->nblocks = 0;
+	d->ninsn = 0;
+	for(i=0; i<words; i++)
+	{
+		if(!(i & 7) && !(d->bb[i >> 3] & d->insn[i >> 3]))
+		{
+			i += 7;
+			continue;
+		}
+		addr = i * 2;
+		if(!bit_test(d->bb, addr) || !bit_test(d->insn, addr))
+			continue;
+		disc_cut(d, addr, &d->block[d->nblocks]);
+		d->ninsn += d->block[d->nblocks++].ninsn;
+	}
+	return 0;
+}
+
+int u8_disc_find_block(const struct u8_disc *d, ut32 addr)
+{
+	int lo=0, hi=d->nblocks, mid;
+
+	while(lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if(d->block[mid].addr < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < (int)d->nblocks && d->block[lo].addr == addr ? lo : -1;
+}
+
+// blocks of one function: depth first from the entry, not entering other
+// functions (tail calls)
+static int disc_gather(struct disc_worker *w, ut32 index)
+{
+	struct u8_disc *d = w->run->d;
+	struct u8_disc_func *f = &d->func[index];
+	const struct u8_disc_block *b;
+	ut32 top=0, succ[2], s;
+	int k, j;
+
+	if((k = u8_disc_find_block(d, f->addr)) < 0)
+		return 0;
+	if(!(f->blocks = malloc(16 * sizeof(*f->blocks))))
+		return -1;
+
+	w->stack[top++] = k;
+	w->mark[k] = index + 1;
+	while(top)
+	{
+		k = w->stack[--top];
+		b = &d->block[k];
+		if((f->nblocks & (f->nblocks - 1)) == 0 && f->nblocks >= 16)
+		{
+			ut32 *p = realloc(f->blocks, f->nblocks * 2 * sizeof(*p));
+
+			if(!p)
+				return -1;
+			f->blocks = p;
+		}
+		f->blocks[f->nblocks++] = k;
+		f->size += b->size;
+
+		// fail first, so the taken side is walked first
+		succ[0] = b->fail;
+		succ[1] = b->jump;
+		for(s=0; s<2; s++)
+		{
+			if(succ[s] == U8_NO_ADDR || succ[s] >= d->size || bit_test(d->fn, succ[s]))
+				continue;
+			if((j = u8_disc_find_block(d, succ[s])) < 0 || w->mark[j] == index + 1)
+				continue;
+			w->mark[j] = index + 1;
+			w->stack[top++] = j;
+		}
+	}
+	return 0;
+}
+
+static void *disc_func_worker(void *arg)
+{
+	struct disc_worker *w = arg;
+	struct disc_run *run = w->run;
+	ut32 index;
+
+	while((index = __atomic_fetch_add(&run->next_func, 1, __ATOMIC_RELAXED)) < run->d->nfuncs)
+	{
+		if(disc_gather(w, index) < 0)
+			w->error = 1;
+	}
+	return NULL;
+}
+
+// run 'fn' on 'nthreads' workers, the first on the calling thread
+static void disc_parallel(struct disc_run *run, void *(*fn)(void *))
+{
+	int k;
+
+	for(k=1; k<run->nworkers; k++)
+		run->w[k].threaded = !pthread_create(&run->w[k].thread, NULL, fn, &run->w[k]);
+	for(k=0; k<run->nworkers; k++)
+	{
+		if(!run->w[k].threaded)
+			fn(&run->w[k]);
+	}
+	for(k=1; k<run->nworkers; k++)
+	{
+		if(run->w[k].threaded)
+			pthread_join(run->w[k].thread, NULL);
+		run->w[k].threaded = 0;
+	}
+}
+
+// Discover code from 'roots' (function entries) on 'nthreads' threads
+// (0 = one per CPU). Can be called again with more roots; blocks and
+// functions are rebuilt from all code found so far.
+//	returns the number of functions, or -1 if out of memory
+int u8_disc_run(struct u8_disc *d, const ut32 *roots, int nroots, int nthreads)
+{
+	struct disc_run run;
+	ut32 i, n, words = (d->size + 1) / 2;
+	int k, error=0;
+
+	if(nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if(nthreads < 1)
+		nthreads = 1;
+	if(d->mapped && disc_to_heap(d) < 0)
+		return -1;
+
+	memset(&run, 0, sizeof(run));
+	run.d = d;
+	run.nworkers = nthreads;
+	if(posix_memalign((void **)&run.w, 64, nthreads * sizeof(*run.w)))
+		return -1;
+	memset(run.w, 0, nthreads * sizeof(*run.w));
+	for(k=0; k<nthreads; k++)
+	{
+		pthread_mutex_init(&run.w[k].lock, NULL);
+		run.w[k].run = &run;
+		run.w[k].index = k;
+	}
+
+	// phase 1: walk, roots dealt out round robin
+	for(k=0; k<nroots; k++)
+	{
+		if(!(roots[k] & 1) && roots[k] < d->size)
+			disc_push(&run.w[k % nthreads], roots[k] | DISC_FN);
+	}
+	disc_parallel(&run, disc_worker);
+	for(k=0; k<nthreads; k++)
+		error |= run.w[k].error;
+
+	// phase 2: blocks
+	disc_free_results(d);
+	if(!error && disc_blocks(d) < 0)
+		error = 1;
+
+	// phase 3: functions
+	for(i=0, n=0; !error && i<(words + 7) / 8; i++)
+		n += __builtin_popcount(d->fn[i] & d->insn[i]);
+	if(!error && n)
+	{
+		if(!(d->func = calloc(n, sizeof(*d->func))))
+			error = 1;
+		for(i=0; !error && i<words; i++)
+		{
+			if(bit_test(d->fn, i * 2) && bit_test(d->insn, i * 2))
+				d->func[d->nfuncs++].addr = i * 2;
+		}
+		for(k=0; !error && k<nthreads; k++)
+		{
+			run.w[k].mark = calloc(d->nblocks, sizeof(*run.w[k].mark));
+			run.w[k].stack = malloc(d->nblocks * sizeof(*run.w[k].stack));
+			if(!run.w[k].mark || !run.w[k].stack)
+				error = 1;
+		}
+		if(!error)
+			disc_parallel(&run, disc_func_worker);
+	}
+
+	for(k=0; k<nthreads; k++)
+	{
+		error |= run.w[k].error;
+		free(run.w[k].item);
+		free(run.w[k].mark);
+		free(run.w[k].stack);
+		pthread_mutex_destroy(&run.w[k].lock);
+	}
+	free(run.w);
+	return error ? -1 : (int)d->nfuncs;
+}
+
+// decode at 'at' as the image was before bytes 'addr'..'addr+len-1' were
+// replaced; 'old' holds what they were
+static int disc_decode_old(const struct u8_disc *d, ut32 at, ut32 addr, const ut8 *old, ut32 len,
+	struct u8_cmd *cmd)
+{
+	ut8 buf[8];
+	ut32 i, n = d->size - at < sizeof(buf) ? d->size - at : sizeof(buf);
+
+	memcpy(buf, d->rom + at, n);
+	for(i=0; i<n; i++)
+	{
+		if(at + i >= addr && at + i - addr < len)
+			buf[i] = old[at + i - addr];
+	}
+	return u8_decode(buf, n, cmd);
+}
+
+// last block starting at or before 'addr', or -1
+static int disc_block_floor(const struct u8_disc *d, ut32 addr)
+{
+	int lo=0, hi=d->nblocks, mid;
+
+	while(lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if(d->block[mid].addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo - 1;
+}
+
+// first block that can hold bytes at or after 'addr': blocks overlap in
+// misaligned code, so look back as far as the longest one ('span') reaches
+static ut32 disc_block_over(const struct u8_disc *d, ut32 addr, ut32 span)
+{
+	int k = disc_block_floor(d, addr);
+
+	while(k > 0 && d->block[k-1].addr + span > addr)
+		k--;
+	return k < 0 ? 0 : k;
+}
+
+static void disc_dirty_block(struct u8_disc *d, ut32 k)
+{
+	ut32 a;
+
+	for(a=d->block[k].addr; a < d->block[k].addr + d->block[k].size; a+=2)
+		bit_set(d->dirty, a);
+}
+
+static int addr_cmp(const void *a, const void *b)
+{
+	ut32 x = *(const ut32 *)a, y = *(const ut32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int func_cmp(const void *a, const void *b)
+{
+	const struct u8_disc_func *x = a, *y = b;
+
+	return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+// Bring the results up to date after the image bytes 'addr'..'addr+len-1'
+// changed; d->rom already holds the new bytes, 'old' what they were.
+//
+// Instructions are re-decoded only in the blocks that covered a changed
+// byte - including a 2-word instruction or DSR prefix whose tail was
+// changed - and walked again from those block starts. Blocks are cut again
+// only where the walk set new bits, and functions gathered again only if
+// one of their blocks changed. The handler in a changed vector slot is
+// walked as a new root, and every swi through a changed slot re-derived. Code the change cut off stays decoded - the roots
+// that reached it are not known here - so the results can hold more than a
+// fresh u8_disc_run() would. The words re-derived are left in d->dirty,
+// for u8_xref_update().
+//	returns 0, or -1 if out of memory (results then need a u8_disc_run())
+int u8_disc_update(struct u8_disc *d, ut32 addr, const ut8 *old, ut32 len)
+{
+	struct disc_run run;
+	struct disc_worker *w;
+	struct u8_disc_block *block=NULL, *p;
+	struct u8_disc_func *func=NULL, *f, key;
+	struct u8_cmd cmd;
+	ut32 *remap=NULL, *fresh=NULL, i, j, a, jump, fail, lim, wd, nblocks=0, max=0, nfresh=0, nfuncs=0, span=0;
+	int error=0, dirty;
+
+	if(d->mapped && disc_to_heap(d) < 0)
+		return -1;
+	if(addr >= d->size || !len)
+		return 0;
+	if(len > d->size - addr)
+		len = d->size - addr;
+	if(d->dirty)
+		memset(d->dirty, 0, U8_DISC_WORDS / 8);
+	else if(!(d->dirty = calloc(U8_DISC_WORDS / 8, 1)))
+		return -1;
+
+	memset(&run, 0, sizeof(run));
+	if(posix_memalign((void **)&w, 64, sizeof(*w)))
+		return -1;
+	memset(w, 0, sizeof(*w));
+	pthread_mutex_init(&w->lock, NULL);
+	w->run = &run;
+	run.d = d;
+	run.w = w;
+	run.nworkers = 1;
+	run.track = 1;
+
+	// blocks over the changed bytes: forget their instructions as they
+	// were, walk again from their starts
+	for(i=0; i<d->nblocks; i++)
+	{
+		if(d->block[i].size > span)
+			span = d->block[i].size;
+	}
+	for(i=disc_block_over(d, addr, span); i < d->nblocks && d->block[i].addr < addr + len; i++)
+	{
+		if(d->block[i].addr + d->block[i].size <= addr)
+			continue;
+		disc_dirty_block(d, i);
+		for(a=d->block[i].addr, j=0; j<d->block[i].ninsn && a != U8_NO_ADDR; j++)
+		{
+			if(disc_decode_old(d, a, addr, old, len, &cmd) < 0)
+				break;
+			d->insn[a >> 4] &= ~(1 << ((a >> 1) & 7));
+			u8_flow(&cmd, a, &jump, &fail);
+			a = fail;
+		}
+		a = d->block[i].addr;
+		disc_push(w, a | (bit_test(d->fn, a) ? DISC_FN : 0));
+	}
+	// vector slots: the new handler is a root, as u8_disc_vectors() would
+	// give it; swi reaches its handler through the table, so a changed
+	// swi slot changes every swi through it
+	for(a=addr & ~1; a < U8_VECTORS * 2 && a < addr + len; a+=2)
+	{
+		if(a && (jump = u8_vector_target(d->rom, d->size, a)) != U8_NO_ADDR)
+			disc_push(w, jump | DISC_FN);
+	}
+	if(addr < U8_VECTORS * 2 && addr + len > U8_VEC_SWI_BASE)
+	{
+		for(a=0; a<d->size; a+=2)
+		{
+			if(!(a & 15) && !d->insn[a >> 4])
+			{
+				a += 14;
+				continue;
+			}
+			if(bit_test(d->insn, a) && u8_decode(d->rom + a, d->size - a, &cmd) >= 0 &&
+				u8_flow(&cmd, a, &jump, &fail) == U8_FLOW_SWI && jump + 2 > addr && jump < addr + len)
+				bit_set(d->dirty, a);
+		}
+	}
+	disc_worker(w);
+	error |= w->error | run.error;
+
+	// a new bit changes the old block it falls in, and the one ending
+	// just before it (which may now fall through into it)
+	for(i=0; i<run.nchanged; i++)
+	{
+		a = run.changed[i];
+		bit_set(d->dirty, a);
+		for(j=disc_block_over(d, a ? a - 1 : 0, span); j < d->nblocks && d->block[j].addr <= a; j++)
+		{
+			if(d->block[j].addr + d->block[j].size >= a)
+				disc_dirty_block(d, j);
+		}
+	}
+
+	// blocks: clean ones kept, dirty words cut again, in address order
+	if(!error && d->nblocks && !(remap = malloc(d->nblocks * sizeof(*remap))))
+		error = 1;
+	for(i=0, wd=0; !error && i<=d->nblocks; i++)
+	{
+		lim = i < d->nblocks ? d->block[i].addr : d->size;
+		for(; wd * 2 < lim; wd++)
+		{
+			if(!(wd & 7) && !d->dirty[wd >> 3])
+			{
+				wd += 7;
+				continue;
+			}
+			if(!bit_test(d->dirty, wd * 2) || !bit_test(d->bb, wd * 2) || !bit_test(d->insn, wd * 2))
+				continue;
+			if(nblocks == max)
+			{
+				max = max ? max * 2 : d->nblocks + 64;
+				if(!(p = realloc(block, max * sizeof(*p))))
+				{
+					error = 1;
+					break;
+				}
+				block = p;
+			}
+			disc_cut(d, wd * 2, &block[nblocks]);
+			d->ninsn += block[nblocks++].ninsn;
+		}
+		if(error || i == d->nblocks)
+			break;
+
+		if(bit_test(d->dirty, d->block[i].addr))
+		{
+			remap[i] = U8_NO_ADDR;
+			d->ninsn -= d->block[i].ninsn;
+			continue;
+		}
+		if(nblocks == max)
+		{
+			max = max ? max * 2 : d->nblocks + 64;
+			if(!(p = realloc(block, max * sizeof(*p))))
+			{
+				error = 1;
+				break;
+			}
+			block = p;
+		}
+		remap[i] = nblocks;
+		block[nblocks++] = d->block[i];
+	}
+
+	// functions: new entries, then the old ones whose entry is still code
+	for(i=0; !error && i<run.nchanged; i++)
+	{
+		a = run.changed[i];
+		key.addr = a;
+		if(!bit_test(d->fn, a) || !bit_test(d->insn, a) ||
+			bsearch(&key, d->func, d->nfuncs, sizeof(*d->func), func_cmp))
+			continue;
+		if(!(nfresh & (nfresh - 1)))
+		{
+			ut32 *q = realloc(fresh, (nfresh ? nfresh * 2 : 16) * sizeof(*q));
+
+			if(!q)
+			{
+				error = 1;
+				break;
+			}
+			fresh = q;
+		}
+		fresh[nfresh++] = a;
+	}
+	if(!error && !(func = malloc((d->nfuncs + nfresh + 1) * sizeof(*func))))
+		error = 1;
+	for(i=0; !error && i<d->nfuncs; i++)
+	{
+		f = &d->func[i];
+		if(!bit_test(d->insn, f->addr))
+		{
+			free(f->blocks);
+			continue;
+		}
+		dirty = bit_test(d->dirty, f->addr);
+		for(j=0; !dirty && j<f->nblocks; j++)
+		{
+			if(remap[f->blocks[j]] == U8_NO_ADDR)
+				dirty = 1;
+			else
+				f->blocks[j] = remap[f->blocks[j]];
+		}
+		if(dirty)
+		{
+			// gathered again below
+			free(f->blocks);
+			f->blocks = NULL;
+			f->nblocks = 0;
+			f->size = U8_NO_ADDR;
+		}
+		func[nfuncs++] = *f;
+	}
+	if(!error && nfresh)
+	{
+		// an address can show up once per bitmap
+		qsort(fresh, nfresh, sizeof(*fresh), addr_cmp);
+		for(i=0; i<nfresh; i++)
+		{
+			if(i && fresh[i] == fresh[i-1])
+				continue;
+			func[nfuncs].addr = fresh[i];
+			func[nfuncs].blocks = NULL;
+			func[nfuncs].nblocks = 0;
+			func[nfuncs++].size = U8_NO_ADDR;
+		}
+		qsort(func, nfuncs, sizeof(*func), func_cmp);
+	}
+
+	if(!error)
+	{
+		free(d->block);
+		free(d->func);
+		d->block = block;
+		d->nblocks = nblocks;
+		d->func = func;
+		d->nfuncs = nfuncs;
+		block = NULL;
+		func = NULL;
+
+		w->mark = calloc(nblocks + 1, sizeof(*w->mark));
+		w->stack = malloc((nblocks + 1) * sizeof(*w->stack));
+		if(!w->mark || !w->stack)
+			error = 1;
+		for(i=0; !error && i<d->nfuncs; i++)
+		{
+			if(d->func[i].size != U8_NO_ADDR)
+				continue;
+			d->func[i].size = 0;
+			if(disc_gather(w, i) < 0)
+				error = 1;
+		}
+	}
+
+	free(block);
+	free(func);
+	free(remap);
+	free(fresh);
+	free(run.changed);
+	free(w->item);
+	free(w->mark);
+	free(w->stack);
+	pthread_mutex_destroy(&w->lock);
+	free(w);
+	return error ? -1 : 0;
+}
@@ -0,0 +1,94 @@
+/* nX-U8/100 recursive code discovery - LGPL - Copyright 2020 - cetus9 */
+
+#ifndef U8_DISC_H
+#define U8_DISC_H
+
+#include <r_types.h>
+
+#include "u8_disas.h"
+
+#define U8_DISC_CODE_MAX	0x100000	// 16 segments of 64K
+#define U8_DISC_WORDS		(U8_DISC_CODE_MAX / 2)
+
+// bit for the word at 'addr' in one of the bitmaps below
+#define U8_DISC_BIT(map, addr)	(((map)[(addr) >> 4] >> (((addr) >> 1) & 7)) & 1)
+
+// vector table, 00h..feh of segment 0
+#define U8_VECTORS		128
+#define U8_VEC_SWI_BASE		0x80	// swi #0..63
+
+enum
+{
+	U8_VEC_SP,		// initial stack pointer, not code
+	U8_VEC_RESET,
+	U8_VEC_BRK,
+	U8_VEC_NMI,
+	U8_VEC_INT,		// maskable interrupt
+	U8_VEC_SWI,
+};
+
+struct u8_vector
+{
+	ut32 addr;		// table entry
+	ut32 target;		// handler (SP value for U8_VEC_SP), U8_NO_ADDR if
+				// unprogrammed or not a code address
+	int kind;
+	char name[12];		// "reset", "int_0a", "swi_12"
+};
+
+// basic block: ends at a branch, return or stop, or where another block
+// starts
+struct u8_disc_block
+{
+	ut32 addr;
+	ut32 size;		// bytes
+	ut32 ninsn;
+	ut32 jump;		// branch target or the next block, U8_NO_ADDR if none
+	ut32 fail;		// conditional branch not taken, U8_NO_ADDR if none
+};
+
+// function: its entry block and the blocks reached from it without
+// passing through another function's entry
+struct u8_disc_func
+{
+	ut32 addr;
+	ut32 size;		// bytes in its blocks
+	ut32 nblocks;
+	ut32 *blocks;		// indexes into u8_disc.block[], entry first
+};
+
+struct u8_disc
+{
+	const ut8 *rom;
+	ut32 size;
+
+	// bit per code word
+	ut8 *insn;		// instruction start reached
+	ut8 *bb;		// basic block start
+	ut8 *fn;		// function entry
+	ut8 *dirty;		// words re-derived by the last u8_disc_update()
+
+	// results, by address
+	struct u8_disc_block *block;
+	ut32 nblocks;
+	struct u8_disc_func *func;
+	ut32 nfuncs;
+	ut64 ninsn;
+
+	// cache file loaded by u8_db_load(), kept until u8_disc_fini() (the
+	// xrefs loaded with it point into it too)
+	void *map;
+	size_t map_size;
+	int mapped;		// bitmaps and blocks still in the mapping
+};
+
+int u8_disc_init(struct u8_disc *d, const ut8 *rom, ut32 size);
+void u8_disc_fini(struct u8_disc *d);
+int u8_vectors(const ut8 *rom, ut32 size, struct u8_vector *vec);
+ut32 u8_vector_target(const ut8 *rom, ut32 size, ut32 addr);
+int u8_disc_vectors(const ut8 *rom, ut32 size, ut32 *roots, int max);
+int u8_disc_run(struct u8_disc *d, const ut32 *roots, int nroots, int nthreads);
+int u8_disc_find_block(const struct u8_disc *d, ut32 addr);
+int u8_disc_update(struct u8_disc *d, ut32 addr, const ut8 *old, ut32 len);
+
+#endif /* U8_DISC_H */
@@ -0,0 +1,2270 @@
+/* nX-U8/100 emulator - LGPL - Copyright 2020 - cetus9 */
+
+// Instruction set emulator built on u8inst[] and u8_decode(). Code is
+// decoded a basic block at a time into icache[]; the run loop then only
+// dispatches on the cached entry. Flags are written back through the
+// 'flags' column of u8_insn.def, so only the flags the core reference lists
+// for an instruction are changed, and are not computed at all where the
+// block overwrites them before anything reads them (see emu_translate()).
+//
+// Memory: code is fetched from the ROM at CSR:PC, segment n at offset
+// n * 64K of the image. Data memory (DSR:addr) is a table of 4K pages, each
+// pointing straight into the ROM image, at a RAM page or at nothing for
+// SFRs, so an ordinary access is one table lookup. By default segment 0 has
+// the ROM below 8000h, RAM up to efffh and SFRs from f000h; other segments
+// read the image where it has data and are RAM beyond it. RAM pages are
+// allocated on first write. Accesses without a DSR prefix go to segment 0,
+// as do stack accesses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include <r_types.h>
+
+#include "u8_emu.h"
+#include "u8_trace.h"
+
+#define ER(n)		(e->r[(n) & 0xe] | (e->r[((n) & 0xe) + 1] << 8))
+#define ELEVEL		(e->psw & U8_PSW_ELEVEL)
+#define CODE_ADDR	(((ut32)e->csr << 16) | e->pc)
+
+static inline void set_er(struct u8_emu *e, int n, ut16 v)
+{
+	e->r[n & 0xe] = v;
+	e->r[(n & 0xe) + 1] = v >> 8;
+}
+
+#define PAGE(a)		((a) >> U8_EMU_PAGE_BITS)
+#define PAGE_OFF(a)	((a) & (U8_EMU_PAGE_SIZE - 1))
+#define IS_SFR(e, p)	((e)->sfr_map[(p) >> 3] & (1 << ((p) & 7)))
+#define IS_RAM(e, p)	((e)->ram_map[(p) >> 3] & (1 << ((p) & 7)))
+
+// read by RAM pages not written yet, and by ROM pages past the image
+static const ut8 zero_page[U8_EMU_PAGE_SIZE];
+static const ut8 erased_page[U8_EMU_PAGE_SIZE] = {[0 ... U8_EMU_PAGE_SIZE - 1] = 0xff};
+
+// RAM page with its own memory (written at some point)
+static inline ut8 *ram_page(struct u8_emu *e, ut32 p)
+{
+	return IS_RAM(e, p) && e->rd_page[p] != zero_page ? (ut8 *)e->rd_page[p] : NULL;
+}
+
+// SFR handlers see the count of instructions run before the current one,
+// also inside a block where icount was counted up front
+static inline ut64 sfr_enter(struct u8_emu *e)
+{
+	ut64 adj = e->cur ? e->cur->left : 0;
+
+	e->icount -= adj;
+	return adj;
+}
+
+// access to a page without a direct pointer
+static ut8 rd_slow(struct u8_emu *e, ut32 a)
+{
+	ut64 adj;
+	ut8 v;
+
+	if(!e->sfr_read)
+		return e->sfr[PAGE_OFF(a)];
+	adj = sfr_enter(e);
+	v = e->sfr_read(e, a);
+	e->icount += adj;
+	return v;
+}
+
+static void wr_slow(struct u8_emu *e, ut32 a, ut8 v)
+{
+	ut32 p = PAGE(a);
+	ut64 adj;
+
+	if(IS_SFR(e, p))
+	{
+		if(e->sfr_write)
+		{
+			adj = sfr_enter(e);
+			e->sfr_write(e, a, v);
+			e->icount += adj;
+		}
+		else
+			e->sfr[PAGE_OFF(a)] = v;
+		return;
+	}
+
+	if(!IS_RAM(e, p))
+		return;				// ROM - ignored
+
+	// first write to a RAM page - since the snapshot, or at all; dropped
+	// if out of memory
+	if(e->rd_page[p] == zero_page && !(e->rd_page[p] = calloc(1, U8_EMU_PAGE_SIZE)))
+	{
+		e->rd_page[p] = zero_page;
+		return;
+	}
+	// listed once - the second byte of a word store comes back here with
+	// the page already writable
+	if(e->snap && !e->wr_page[p])
+		e->dirty[e->ndirty++] = p;
+	e->wr_page[p] = (ut8 *)e->rd_page[p];
+	e->wr_page[p][PAGE_OFF(a)] = v;
+}
+
+// data memory - word accesses ignore address bit 0
+static inline ut8 rd8(struct u8_emu *e, ut8 seg, ut16 off)
+{
+	ut32 a = ((ut32)seg << 16) | off;
+	const ut8 *page = e->rd_page[PAGE(a)];
+
+	if(page)
+		return page[PAGE_OFF(a)];
+	return rd_slow(e, a);
+}
+
+static inline ut16 rd16(struct u8_emu *e, ut8 seg, ut16 off)
+{
+	ut32 a = ((ut32)seg << 16) | (off & 0xfffe);
+	const ut8 *page = e->rd_page[PAGE(a)];
+
+	if(page)
+		return r_read_at_le16(page, PAGE_OFF(a));
+	return rd_slow(e, a) | (rd_slow(e, a + 1) << 8);
+}
+
+static inline void wr8(struct u8_emu *e, ut8 seg, ut16 off, ut8 v)
+{
+	ut32 a = ((ut32)seg << 16) | off;
+	ut8 *page = e->wr_page[PAGE(a)];
+
+	if(e->trace)
+		u8_trace_wr(e->trace, a, v);
+	if(page)
+		page[PAGE_OFF(a)] = v;
+	else
+		wr_slow(e, a, v);
+}
+
+static inline void wr16(struct u8_emu *e, ut8 seg, ut16 off, ut16 v)
+{
+	ut32 a = ((ut32)seg << 16) | (off & 0xfffe);
+	ut8 *page = e->wr_page[PAGE(a)];
+
+	if(e->trace)
+	{
+		u8_trace_wr(e->trace, a, v);
+		u8_trace_wr(e->trace, a + 1, v >> 8);
+	}
+	if(page)
+		r_write_at_le16(page, v, PAGE_OFF(a));
+	else
+	{
+		wr_slow(e, a, v);
+		wr_slow(e, a + 1, v >> 8);
+	}
+}
+
+// n bytes of registers from/to consecutive words (XRn, QRn, CRn..)
+static void rd_regs(struct u8_emu *e, ut8 seg, ut16 off, ut8 *reg, int n)
+{
+	int i;
+
+	for(i=0; i<n; i+=2)
+	{
+		ut16 v = rd16(e, seg, off + i);
+		reg[i] = v;
+		reg[i+1] = v >> 8;
+	}
+}
+
+static void wr_regs(struct u8_emu *e, ut8 seg, ut16 off, const ut8 *reg, int n)
+{
+	int i;
+
+	for(i=0; i<n; i+=2)
+		wr16(e, seg, off + i, reg[i] | (reg[i+1] << 8));
+}
+
+// code memory
+static inline ut16 rom16(struct u8_emu *e, ut32 addr)
+{
+	if(addr + 1 >= e->rom_size)
+		return 0xffff;
+	return r_read_at_le16(e->rom, addr);
+}
+
+// PSW changed - a pending interrupt may be taken now
+static inline void irq_recheck(struct u8_emu *e)
+{
+	if(e->irq)
+	{
+		e->ev_next = 0;
+		e->resched = 1;
+	}
+}
+
+// flags written by instruction 't', as PSW bits
+static inline ut8 flags_mask(int t)
+{
+	return u8inst[t].flags << 2;		// C Z S OV MIE HC -> PSW bits 7..2
+}
+
+// update only the PSW bits in 'fm' - the instruction's flags, less any the
+// block translator found dead
+static inline void set_flags(struct u8_emu *e, ut8 fm, ut8 f)
+{
+	e->psw = (e->psw & ~fm) | (f & fm);
+}
+
+static inline ut8 flags_zs8(ut8 v)
+{
+	return (v ? 0 : U8_PSW_Z) | (v & 0x80 ? U8_PSW_S : 0);
+}
+
+static inline ut8 flags_zs16(ut16 v)
+{
+	return (v ? 0 : U8_PSW_Z) | (v & 0x8000 ? U8_PSW_S : 0);
+}
+
+// Z and S of an n byte register group (ERn, XRn, QRn)
+static inline ut8 flags_zs_regs(const ut8 *reg, int n)
+{
+	ut8 any=0;
+	int i;
+
+	for(i=0; i<n; i++)
+		any |= reg[i];
+	return (any ? 0 : U8_PSW_Z) | (reg[n-1] & 0x80 ? U8_PSW_S : 0);
+}
+
+// 'zkeep': Z stays set only if it was set before (addc, subc, cmpc)
+static inline ut8 alu_add8(struct u8_emu *e, ut8 fm, ut8 a, ut8 b, int c, int zkeep)
+{
+	unsigned int r = a + b + c;
+	ut8 f;
+
+	if(!fm)
+		return r;
+	f = flags_zs8(r);
+
+	if(zkeep && !(e->psw & U8_PSW_Z))
+		f &= ~U8_PSW_Z;
+	if(r & 0x100)
+		f |= U8_PSW_C;
+	if(~(a ^ b) & (a ^ r) & 0x80)
+		f |= U8_PSW_OV;
+	if((a & 0xf) + (b & 0xf) + c > 0xf)
+		f |= U8_PSW_HC;
+	set_flags(e, fm, f);
+
+	return r;
+}
+
+static inline ut8 alu_sub8(struct u8_emu *e, ut8 fm, ut8 a, ut8 b, int c, int zkeep)
+{
+	unsigned int r = a - b - c;
+	ut8 f;
+
+	if(!fm)
+		return r;
+	f = flags_zs8(r);
+
+	if(zkeep && !(e->psw & U8_PSW_Z))
+		f &= ~U8_PSW_Z;
+	if(a < b + c)
+		f |= U8_PSW_C;
+	if((a ^ b) & (a ^ r) & 0x80)
+		f |= U8_PSW_OV;
+	if((a & 0xf) < (b & 0xf) + c)
+		f |= U8_PSW_HC;
+	set_flags(e, fm, f);
+
+	return r;
+}
+
+static inline ut16 alu_add16(struct u8_emu *e, ut8 fm, ut16 a, ut16 b)
+{
+	unsigned int r = a + b;
+	ut8 f;
+
+	if(!fm)
+		return r;
+	f = flags_zs16(r);
+
+	if(r & 0x10000)
+		f |= U8_PSW_C;
+	if(~(a ^ b) & (a ^ r) & 0x8000)
+		f |= U8_PSW_OV;
+	if((a & 0xfff) + (b & 0xfff) > 0xfff)
+		f |= U8_PSW_HC;
+	set_flags(e, fm, f);
+
+	return r;
+}
+
+static inline ut16 alu_sub16(struct u8_emu *e, ut8 fm, ut16 a, ut16 b)
+{
+	unsigned int r = a - b;
+	ut8 f;
+
+	if(!fm)
+		return r;
+	f = flags_zs16(r);
+
+	if(a < b)
+		f |= U8_PSW_C;
+	if((a ^ b) & (a ^ r) & 0x8000)
+		f |= U8_PSW_OV;
+	if((a & 0xfff) < (b & 0xfff))
+		f |= U8_PSW_HC;
+	set_flags(e, fm, f);
+
+	return r;
+}
+
+// shifts by 0..7; C is the last bit shifted out, unchanged for 0
+static ut8 alu_shift(struct u8_emu *e, int t, ut8 fm, int n, int w)
+{
+	ut8 a = e->r[n], r;
+	int c;
+
+	if(!w)
+		return a;
+
+	switch(t)
+	{
+		case U8_SLL_R:
+		case U8_SLL_O:
+			r = a << w;
+			c = (a >> (8 - w)) & 1;
+			break;
+		case U8_SLLC_R:
+		case U8_SLLC_O:
+			r = (a << w) | (e->r[(n - 1) & 0xf] >> (8 - w));
+			c = (a >> (8 - w)) & 1;
+			break;
+		case U8_SRA_R:
+		case U8_SRA_O:
+			r = (st8)a >> w;
+			c = (a >> (w - 1)) & 1;
+			break;
+		case U8_SRL_R:
+		case U8_SRL_O:
+			r = a >> w;
+			c = (a >> (w - 1)) & 1;
+			break;
+		default:		// SRLC
+			r = (a >> w) | (e->r[(n + 1) & 0xf] << (8 - w));
+			c = (a >> (w - 1)) & 1;
+			break;
+	}
+	set_flags(e, fm, c ? U8_PSW_C : 0);
+
+	return r;
+}
+
+static inline int branch_taken(struct u8_emu *e, int t)
+{
+	int c = (e->psw & U8_PSW_C) != 0, z = (e->psw & U8_PSW_Z) != 0;
+	int s = (e->psw & U8_PSW_S) != 0, ov = (e->psw & U8_PSW_OV) != 0;
+
+	switch(t)
+	{
+		case U8_BGE_RAD:	return !c;
+		case U8_BLT_RAD:	return c;
+		case U8_BGT_RAD:	return !c && !z;
+		case U8_BLE_RAD:	return c || z;
+		case U8_BGES_RAD:	return !(ov ^ s);
+		case U8_BLTS_RAD:	return ov ^ s;
+		case U8_BGTS_RAD:	return !((ov ^ s) | z);
+		case U8_BLES_RAD:	return (ov ^ s) | z;
+		case U8_BNE_RAD:	return !z;
+		case U8_BEQ_RAD:	return z;
+		case U8_BNV_RAD:	return !ov;
+		case U8_BOV_RAD:	return ov;
+		case U8_BPS_RAD:	return !s;
+		case U8_BNS_RAD:	return s;
+	}
+	return 1;			// BAL
+}
+
+static inline st16 disp6(ut16 v)
+{
+	return (v & 0x20) ? (st16)v - 0x40 : v;
+}
+
+static inline st16 imm7(ut16 v)
+{
+	return (v & 0x40) ? (st16)v - 0x80 : v;
+}
+
+// decode instruction at code address 'addr' into its cache entry, all but
+// the length, which marks the entry valid
+//	returns the length, 0 if it cannot be decoded
+static int emu_decode(struct u8_emu *e, ut32 addr)
+{
+	struct u8_emu_ent *ent = &e->icache[addr >> 1];
+	const ut8 *p = e->rom + addr;
+	struct u8_cmd cmd;
+	ut32 a;
+	ut8 buf[6];
+	int len = e->rom_size - addr;
+
+	// PC wraps within the segment, so the words of an instruction at its
+	// end follow on from the segment start
+	if((addr & 0xffff) > 0x10000 - sizeof(buf))
+	{
+		for(len=0; len<(int)sizeof(buf); len+=2)
+		{
+			a = (addr & 0xf0000) | ((addr + len) & 0xffff);
+			if(a + 1 >= e->rom_size)
+				break;
+			buf[len] = e->rom[a];
+			buf[len + 1] = e->rom[a + 1];
+		}
+		p = buf;
+	}
+
+	if(u8_decode(p, len, &cmd) < 0)
+		return 0;
+
+	ent->type = cmd.type;
+	ent->op1 = cmd.op1;
+	ent->op2 = cmd.op2;
+	ent->s_word = cmd.s_word;
+	ent->pre = ent->pre_val = 0;
+	if(cmd.prefix)
+	{
+		ent->pre = u8_decode_inst(cmd.prefix);
+		ent->pre_val = ent->pre == U8_PRE_PSEG ? (cmd.prefix & 0xff) : (cmd.prefix >> 4) & 0xf;
+	}
+
+	return cmd.len;
+}
+
+// entry length, 0 until translated - may be set by another thread sharing
+// the cache (u8_emu_clone()), after the rest of the entry
+static inline int ent_len(const struct u8_emu_ent *ent)
+{
+	return __atomic_load_n(&ent->len, __ATOMIC_ACQUIRE);
+}
+
+// instructions that leave the block: anything that can change PC other
+// than by falling through, or stops the emulator
+static int ends_block(const struct u8_emu_ent *ent)
+{
+	switch(ent->type)
+	{
+		case U8_BGE_RAD: case U8_BLT_RAD: case U8_BGT_RAD: case U8_BLE_RAD:
+		case U8_BGES_RAD: case U8_BLTS_RAD: case U8_BGTS_RAD: case U8_BLES_RAD:
+		case U8_BNE_RAD: case U8_BEQ_RAD: case U8_BNV_RAD: case U8_BOV_RAD:
+		case U8_BPS_RAD: case U8_BNS_RAD: case U8_BAL_RAD:
+		case U8_B_AD: case U8_BL_AD: case U8_B_ER: case U8_BL_ER:
+		case U8_SWI_O: case U8_BRK: case U8_RT: case U8_RTI:
+		case U8_ILL: case U8_PRE_PSEG: case U8_PRE_DSR: case U8_PRE_R:
+			return 1;
+		case U8_POP_RL:
+			return (ent->op1 & 2) != 0;	// pop pc
+	}
+	return 0;
+}
+
+// instructions after which the block may be left early: data accesses
+// (an SFR handler may raise an interrupt or move an event into the block)
+// and PSW writes that can let a pending interrupt in
+static int may_resched(const struct u8_emu_ent *ent)
+{
+	switch(ent->type)
+	{
+		case U8_L_ER_EA: case U8_L_ER_EAP: case U8_L_ER_ER: case U8_L_ER_D16_ER:
+		case U8_L_ER_D6_BP: case U8_L_ER_D6_FP: case U8_L_ER_DA:
+		case U8_L_R_EA: case U8_L_R_EAP: case U8_L_R_ER: case U8_L_R_D16_ER:
+		case U8_L_R_D6_BP: case U8_L_R_D6_FP: case U8_L_R_DA:
+		case U8_L_XR_EA: case U8_L_XR_EAP: case U8_L_QR_EA: case U8_L_QR_EAP:
+		case U8_ST_ER_EA: case U8_ST_ER_EAP: case U8_ST_ER_ER: case U8_ST_ER_D16_ER:
+		case U8_ST_ER_D6_BP: case U8_ST_ER_D6_FP: case U8_ST_ER_DA:
+		case U8_ST_R_EA: case U8_ST_R_EAP: case U8_ST_R_ER: case U8_ST_R_D16_ER:
+		case U8_ST_R_D6_BP: case U8_ST_R_D6_FP: case U8_ST_R_DA:
+		case U8_ST_XR_EA: case U8_ST_XR_EAP: case U8_ST_QR_EA: case U8_ST_QR_EAP:
+		case U8_PUSH_ER: case U8_PUSH_QR: case U8_PUSH_R: case U8_PUSH_XR: case U8_PUSH_RL:
+		case U8_POP_ER: case U8_POP_QR: case U8_POP_R: case U8_POP_XR: case U8_POP_RL:
+		case U8_MOV_CR_EA: case U8_MOV_CR_EAP: case U8_MOV_CER_EA: case U8_MOV_CER_EAP:
+		case U8_MOV_CXR_EA: case U8_MOV_CXR_EAP: case U8_MOV_CQR_EA: case U8_MOV_CQR_EAP:
+		case U8_MOV_EA_CR: case U8_MOV_EAP_CR: case U8_MOV_EA_CER: case U8_MOV_EAP_CER:
+		case U8_MOV_EA_CXR: case U8_MOV_EAP_CXR: case U8_MOV_EA_CQR: case U8_MOV_EAP_CQR:
+		case U8_SB_DBIT: case U8_RB_DBIT: case U8_TB_DBIT:
+		case U8_EI: case U8_MOV_PSW_R: case U8_MOV_PSW_O:
+			return 1;
+	}
+	return 0;
+}
+
+// flags an instruction reads
+static ut8 flags_used(const struct u8_emu_ent *ent)
+{
+	switch(ent->type)
+	{
+		case U8_ADDC_R: case U8_ADDC_O: case U8_SUBC_R: case U8_CMPC_R: case U8_CMPC_O:
+			return U8_PSW_C | U8_PSW_Z;
+		case U8_DAA_R: case U8_DAS_R:
+			return U8_PSW_C | U8_PSW_HC;
+		case U8_CPLC:
+			return U8_PSW_C;
+		case U8_MOV_R_PSW:
+			return U8_EMU_FLAGS;
+	}
+	return 0;
+}
+
+// flags an instruction always overwrites
+static ut8 flags_killed(const struct u8_emu_ent *ent)
+{
+	switch(ent->type)
+	{
+		// count may be 0, C then unchanged
+		case U8_SLL_R: case U8_SLL_O: case U8_SLLC_R: case U8_SLLC_O:
+		case U8_SRA_R: case U8_SRA_O: case U8_SRL_R: case U8_SRL_O:
+		case U8_SRLC_R: case U8_SRLC_O:
+			return 0;
+		case U8_POP_RL:
+			return (ent->op1 & 4) ? U8_EMU_FLAGS : 0;
+	}
+	return flags_mask(ent->type) & U8_EMU_FLAGS;
+}
+
+// threaded code handlers in u8_emu_run(), one per common instruction plus
+// fused pairs; everything else goes through emu_exec()
+enum
+{
+	H_GENERIC,
+	H_ADD_R, H_ADD_O, H_ADDC_R, H_SUB_R, H_MOV_R, H_MOV_O, H_CMP_R, H_CMP_O,
+	H_ADD_ER, H_ADD_ER_O, H_CMP_ER, H_MOV_ER, H_MOV_ER_O, H_ADD_SP_O,
+	H_L_R_EAP, H_ST_R_EAP, H_L_ER_D6_FP, H_ST_ER_D6_FP,
+	H_PUSH_ER, H_POP_ER,
+	H_BCC, H_BL_AD, H_RT,
+	H_CMP_R_BCC,		// cmp rn, rm ; bcc
+	H_CMP_O_BCC,		// cmp rn, #imm ; bcc
+	H_PUSH_LR_ADD_SP,	// push lr ; add sp, #imm - function prologue
+	H_TRACED,		// any instruction, through emu_exec(), recorded
+	H_NUM
+};
+
+static inline int is_bcc(int t)
+{
+	return t >= U8_BGE_RAD && t <= U8_BAL_RAD;
+}
+
+// handler for instruction i of a block of n, fusing it with the next
+static int emu_handler(struct u8_emu_ent **blk, int i, int n)
+{
+	const struct u8_emu_ent *ent = blk[i], *nx = i + 1 < n ? blk[i+1] : NULL;
+
+	switch(ent->type)
+	{
+		case U8_ADD_R:		return H_ADD_R;
+		case U8_ADD_O:		return H_ADD_O;
+		case U8_ADDC_R:		return H_ADDC_R;
+		case U8_SUB_R:		return H_SUB_R;
+		case U8_MOV_R:		return H_MOV_R;
+		case U8_MOV_O:		return H_MOV_O;
+		case U8_CMP_R:		return nx && is_bcc(nx->type) ? H_CMP_R_BCC : H_CMP_R;
+		case U8_CMP_O:		return nx && is_bcc(nx->type) ? H_CMP_O_BCC : H_CMP_O;
+		case U8_ADD_ER:		return H_ADD_ER;
+		case U8_ADD_ER_O:	return H_ADD_ER_O;
+		case U8_CMP_ER:		return H_CMP_ER;
+		case U8_MOV_ER:		return H_MOV_ER;
+		case U8_MOV_ER_O:	return H_MOV_ER_O;
+		case U8_ADD_SP_O:	return H_ADD_SP_O;
+		case U8_PUSH_ER:	return H_PUSH_ER;
+		case U8_POP_ER:		return H_POP_ER;
+		case U8_BL_AD:		return H_BL_AD;
+		case U8_RT:		return H_RT;
+		case U8_PUSH_RL:
+			return ent->op1 == 8 && nx && nx->type == U8_ADD_SP_O ? H_PUSH_LR_ADD_SP : H_GENERIC;
+	}
+	if(is_bcc(ent->type))
+		return H_BCC;
+
+	// memory forms without a DSR prefix
+	if(ent->pre)
+		return H_GENERIC;
+	switch(ent->type)
+	{
+		case U8_L_R_EAP:	return H_L_R_EAP;
+		case U8_ST_R_EAP:	return H_ST_R_EAP;
+		case U8_L_ER_D6_FP:	return H_L_ER_D6_FP;
+		case U8_ST_ER_D6_FP:	return H_ST_ER_D6_FP;
+	}
+	return H_GENERIC;
+}
+
+// Decode the basic block starting at 'addr' and work out which flag results
+// are ever looked at. Walking the block backwards from its exit, where all
+// flags count as live, a flag is dead between an instruction writing it and
+// the next one overwriting it with nothing reading it in between; all are
+// live again after an instruction the block can be left at. Each
+// entry's fmask keeps only the live flags, and 'left' counts the
+// instructions to the end of the block: the run loop only uses fmask when
+// all of them will execute, so the PSW is exact wherever it can stop.
+// Each entry then gets its threaded code handler, from the label addresses
+// in u8_emu_run().
+static struct u8_emu_ent *emu_translate(struct u8_emu *e, ut32 addr, const void *const *handlers)
+{
+	struct u8_emu_ent *blk[U8_EMU_BLOCK_MAX], *ent;
+	ut8 len[U8_EMU_BLOCK_MAX];
+	ut32 a = addr, next;
+	ut8 live;
+	int n=0, i;
+
+	// ends early at an already translated instruction (another block
+	// runs into it), one that cannot be decoded or the end of the segment,
+	// where PC wraps to its start rather than running on into the next
+	while(n < U8_EMU_BLOCK_MAX && a + 1 < e->rom_size && !ent_len(&e->icache[a >> 1]))
+	{
+		if(!(len[n] = emu_decode(e, a)))
+			break;
+		ent = blk[n] = &e->icache[a >> 1];
+		next = a + len[n++];
+		if(ends_block(ent) || (next ^ a) >> 16)
+			break;
+		a = next;
+	}
+	if(!n)
+		return NULL;
+
+	// traced blocks compute every flag and record each instruction -
+	// tracing runs on a decode cache of its own (u8_emu_trace_start())
+	if(e->trace)
+	{
+		for(i=0; i<n; i++)
+		{
+			blk[i]->fmask = flags_mask(blk[i]->type);
+			blk[i]->left = n - i;
+			blk[i]->code = handlers[H_TRACED];
+		}
+		goto publish;
+	}
+
+	live = U8_EMU_FLAGS;
+	for(i=n-1; i>=0; i--)
+	{
+		ent = blk[i];
+		if(may_resched(ent))		// may be the last one run
+			live = U8_EMU_FLAGS;
+		ent->fmask = flags_mask(ent->type) & (live | ~U8_EMU_FLAGS);
+		ent->left = n - i;
+		if(ends_block(ent))		// may stop here, or not run at all
+			live = U8_EMU_FLAGS;
+		else
+			live = (live & ~flags_killed(ent)) | flags_used(ent);
+	}
+	for(i=0; i<n; i++)
+		blk[i]->code = handlers[emu_handler(blk, i, n)];
+
+	// publish, each entry complete before its length is seen and the
+	// block start last, so a thread running from it sees the whole block
+publish:
+	for(i=n-1; i>=0; i--)
+		__atomic_store_n(&blk[i]->len, len[i], __ATOMIC_RELEASE);
+
+	return blk[0];
+}
+
+// emu_translate() on a cache shared between threads, one at a time
+static struct u8_emu_ent *emu_translate_shared(struct u8_emu *e, ut32 addr, const void *const *handlers)
+{
+	struct u8_emu_ent *ent;
+
+	if(!e->lock)
+		return emu_translate(e, addr, handlers);
+
+	pthread_mutex_lock(e->lock);
+	ent = &e->icache[addr >> 1];
+	if(!ent_len(ent))			// not done meanwhile
+		ent = emu_translate(e, addr, handlers);
+	pthread_mutex_unlock(e->lock);
+
+	return ent;
+}
+
+// data segment for this access, DSR updated by the prefix
+static inline ut8 data_seg(struct u8_emu *e, const struct u8_emu_ent *ent)
+{
+	switch(ent->pre)
+	{
+		case 0:
+			return 0;
+		case U8_PRE_PSEG:
+			e->dsr = ent->pre_val; break;
+		case U8_PRE_R:
+			e->dsr = e->r[ent->pre_val]; break;
+	}
+	return e->dsr;
+}
+
+// execute one cached instruction
+//	returns -1 to continue, or a stop reason with pc left on the instruction
+static inline int emu_exec(struct u8_emu *e, const struct u8_emu_ent *ent, ut8 fm)
+{
+	int t = ent->type, n = ent->op1, m = ent->op2, i;
+	ut16 next = e->pc + ent->len, v, off;
+	ut8 seg, b;
+
+	switch(t)
+	{
+		// 8-bit arithmetic and logic
+		case U8_ADD_R:
+			e->r[n] = alu_add8(e, fm, e->r[n], e->r[m], 0, 0); break;
+		case U8_ADD_O:
+			e->r[n] = alu_add8(e, fm, e->r[n], m, 0, 0); break;
+		case U8_ADDC_R:
+			e->r[n] = alu_add8(e, fm, e->r[n], e->r[m], (e->psw & U8_PSW_C) != 0, 1); break;
+		case U8_ADDC_O:
+			e->r[n] = alu_add8(e, fm, e->r[n], m, (e->psw & U8_PSW_C) != 0, 1); break;
+		case U8_SUB_R:
+			e->r[n] = alu_sub8(e, fm, e->r[n], e->r[m], 0, 0); break;
+		case U8_SUBC_R:
+			e->r[n] = alu_sub8(e, fm, e->r[n], e->r[m], (e->psw & U8_PSW_C) != 0, 1); break;
+		case U8_CMP_R:
+			alu_sub8(e, fm, e->r[n], e->r[m], 0, 0); break;
+		case U8_CMP_O:
+			alu_sub8(e, fm, e->r[n], m, 0, 0); break;
+		case U8_CMPC_R:
+			alu_sub8(e, fm, e->r[n], e->r[m], (e->psw & U8_PSW_C) != 0, 1); break;
+		case U8_CMPC_O:
+			alu_sub8(e, fm, e->r[n], m, (e->psw & U8_PSW_C) != 0, 1); break;
+		case U8_AND_R:
+			set_flags(e, fm, flags_zs8(e->r[n] &= e->r[m])); break;
+		case U8_AND_O:
+			set_flags(e, fm, flags_zs8(e->r[n] &= m)); break;
+		case U8_OR_R:
+			set_flags(e, fm, flags_zs8(e->r[n] |= e->r[m])); break;
+		case U8_OR_O:
+			set_flags(e, fm, flags_zs8(e->r[n] |= m)); break;
+		case U8_XOR_R:
+			set_flags(e, fm, flags_zs8(e->r[n] ^= e->r[m])); break;
+		case U8_XOR_O:
+			set_flags(e, fm, flags_zs8(e->r[n] ^= m)); break;
+		case U8_MOV_R:
+			set_flags(e, fm, flags_zs8(e->r[n] = e->r[m])); break;
+		case U8_MOV_O:
+			set_flags(e, fm, flags_zs8(e->r[n] = m)); break;
+
+		// 16-bit arithmetic
+		case U8_ADD_ER:
+			set_er(e, n, alu_add16(e, fm, ER(n), ER(m))); break;
+		case U8_ADD_ER_O:
+			set_er(e, n, alu_add16(e, fm, ER(n), imm7(m))); break;
+		case U8_CMP_ER:
+			alu_sub16(e, fm, ER(n), ER(m)); break;
+		case U8_MOV_ER:
+			v = ER(m);
+			set_er(e, n, v);
+			set_flags(e, fm, flags_zs16(v));
+			break;
+		case U8_MOV_ER_O:
+			v = imm7(m);
+			set_er(e, n, v);
+			set_flags(e, fm, flags_zs16(v));
+			break;
+
+		// shifts
+		case U8_SLL_R:
+		case U8_SLLC_R:
+		case U8_SRA_R:
+		case U8_SRL_R:
+		case U8_SRLC_R:
+			e->r[n] = alu_shift(e, t, fm, n, e->r[m] & 7); break;
+		case U8_SLL_O:
+		case U8_SLLC_O:
+		case U8_SRA_O:
+		case U8_SRL_O:
+		case U8_SRLC_O:
+			e->r[n] = alu_shift(e, t, fm, n, m); break;
+
+		// loads
+		case U8_L_ER_EA:
+		case U8_L_ER_EAP:
+		case U8_L_ER_ER:
+		case U8_L_ER_D16_ER:
+		case U8_L_ER_D6_BP:
+		case U8_L_ER_D6_FP:
+		case U8_L_ER_DA:
+		case U8_L_R_EA:
+		case U8_L_R_EAP:
+		case U8_L_R_ER:
+		case U8_L_R_D16_ER:
+		case U8_L_R_D6_BP:
+		case U8_L_R_D6_FP:
+		case U8_L_R_DA:
+		case U8_L_XR_EA:
+		case U8_L_XR_EAP:
+		case U8_L_QR_EA:
+		case U8_L_QR_EAP:
+
+		// stores
+		case U8_ST_ER_EA:
+		case U8_ST_ER_EAP:
+		case U8_ST_ER_ER:
+		case U8_ST_ER_D16_ER:
+		case U8_ST_ER_D6_BP:
+		case U8_ST_ER_D6_FP:
+		case U8_ST_ER_DA:
+		case U8_ST_R_EA:
+		case U8_ST_R_EAP:
+		case U8_ST_R_ER:
+		case U8_ST_R_D16_ER:
+		case U8_ST_R_D6_BP:
+		case U8_ST_R_D6_FP:
+		case U8_ST_R_DA:
+		case U8_ST_XR_EA:
+		case U8_ST_XR_EAP:
+		case U8_ST_QR_EA:
+		case U8_ST_QR_EAP:
+			seg = data_seg(e, ent);
+
+			// effective address, by operand format
+			switch(u8inst[t].fmt)
+			{
+				case U8_FMT_ER_MER:
+				case U8_FMT_R_MER:
+					off = ER(m); break;
+				case U8_FMT_ER_D16_ER:
+				case U8_FMT_R_D16_ER:
+					off = ER(m) + ent->s_word; break;
+				case U8_FMT_ER_D6_BP:
+				case U8_FMT_R_D6_BP:
+					off = ER(12) + disp6(m); break;
+				case U8_FMT_ER_D6_FP:
+				case U8_FMT_R_D6_FP:
+					off = ER(14) + disp6(m); break;
+				case U8_FMT_ER_DA:
+				case U8_FMT_R_DA:
+					off = ent->s_word; break;
+				default:		// [EA], [EA+]
+					off = e->ea;
+			}
+
+			switch(u8inst[t].fmt)
+			{
+				case U8_FMT_R_EA: case U8_FMT_R_EAP: case U8_FMT_R_MER: case U8_FMT_R_D16_ER:
+				case U8_FMT_R_D6_BP: case U8_FMT_R_D6_FP: case U8_FMT_R_DA:
+					i = 1; break;
+				case U8_FMT_XR_EA: case U8_FMT_XR_EAP:
+					i = 4; break;
+				case U8_FMT_QR_EA: case U8_FMT_QR_EAP:
+					i = 8; break;
+				default:
+					i = 2;
+			}
+
+			// loads come before stores in u8_insn.def
+			if(t <= U8_L_QR_EAP)
+			{
+				if(i == 1)
+					set_flags(e, fm, flags_zs8(e->r[n] = rd8(e, seg, off)));
+				else
+				{
+					rd_regs(e, seg, off, &e->r[n & ~(i - 1)], i);
+					set_flags(e, fm, flags_zs_regs(&e->r[n & ~(i - 1)], i));
+				}
+			}
+			else
+			{
+				if(i == 1)
+					wr8(e, seg, off, e->r[n]);
+				else
+					wr_regs(e, seg, off, &e->r[n & ~(i - 1)], i);
+			}
+
+			switch(u8inst[t].fmt)
+			{
+				case U8_FMT_ER_EAP: case U8_FMT_R_EAP: case U8_FMT_XR_EAP: case U8_FMT_QR_EAP:
+					e->ea += i;
+			}
+			break;
+
+		// control registers
+		case U8_ADD_SP_O:
+			e->sp += (st8)n; break;
+		case U8_MOV_ECSR_R:
+			e->ecsr[ELEVEL] = e->r[n]; break;
+		case U8_MOV_ELR_ER:
+			e->elr[ELEVEL] = ER(n); break;
+		case U8_MOV_EPSW_R:
+			e->epsw[ELEVEL] = e->r[n]; break;
+		case U8_MOV_ER_ELR:
+			set_er(e, n, e->elr[ELEVEL]); break;
+		case U8_MOV_ER_SP:
+			set_er(e, n, e->sp); break;
+		case U8_MOV_PSW_R:
+			e->psw = e->r[n];
+			irq_recheck(e);
+			break;
+		case U8_MOV_PSW_O:
+			e->psw = n;
+			irq_recheck(e);
+			break;
+		case U8_MOV_R_ECSR:
+			e->r[n] = e->ecsr[ELEVEL]; break;
+		case U8_MOV_R_EPSW:
+			e->r[n] = e->epsw[ELEVEL]; break;
+		case U8_MOV_R_PSW:
+			e->r[n] = e->psw; break;
+		case U8_MOV_SP_ER:
+			e->sp = ER(n); break;
+
+		// push/pop - stack is in segment 0, byte pushes take a word
+		case U8_PUSH_R:
+			e->sp -= 2;
+			wr8(e, 0, e->sp, e->r[n]);
+			break;
+		case U8_PUSH_ER:
+			e->sp -= 2;
+			wr16(e, 0, e->sp, ER(n));
+			break;
+		case U8_PUSH_XR:
+			e->sp -= 4;
+			wr_regs(e, 0, e->sp, &e->r[n & 0xc], 4);
+			break;
+		case U8_PUSH_QR:
+			e->sp -= 8;
+			wr_regs(e, 0, e->sp, &e->r[n & 0x8], 8);
+			break;
+		case U8_POP_R:
+			e->r[n] = rd8(e, 0, e->sp);
+			e->sp += 2;
+			break;
+		case U8_POP_ER:
+			set_er(e, n, rd16(e, 0, e->sp));
+			e->sp += 2;
+			break;
+		case U8_POP_XR:
+			rd_regs(e, 0, e->sp, &e->r[n & 0xc], 4);
+			e->sp += 4;
+			break;
+		case U8_POP_QR:
+			rd_regs(e, 0, e->sp, &e->r[n & 0x8], 8);
+			e->sp += 8;
+			break;
+
+		// register lists: pushed elr, epsw, lr, ea - popped in reverse
+		case U8_PUSH_RL:
+			if(n & 2)
+			{
+				if(e->large)
+				{
+					e->sp -= 2;
+					wr16(e, 0, e->sp, e->ecsr[ELEVEL]);
+				}
+				e->sp -= 2;
+				wr16(e, 0, e->sp, e->elr[ELEVEL]);
+			}
+			if(n & 4)
+			{
+				e->sp -= 2;
+				wr8(e, 0, e->sp, e->epsw[ELEVEL]);
+			}
+			if(n & 8)
+			{
+				if(e->large)
+				{
+					e->sp -= 2;
+					wr16(e, 0, e->sp, e->lcsr);
+				}
+				e->sp -= 2;
+				wr16(e, 0, e->sp, e->lr);
+			}
+			if(n & 1)
+			{
+				e->sp -= 2;
+				wr16(e, 0, e->sp, e->ea);
+			}
+			break;
+		case U8_POP_RL:
+			if(n & 1)
+			{
+				e->ea = rd16(e, 0, e->sp);
+				e->sp += 2;
+			}
+			if(n & 8)
+			{
+				e->lr = rd16(e, 0, e->sp);
+				e->sp += 2;
+				if(e->large)
+				{
+					e->lcsr = rd16(e, 0, e->sp) & 0xf;
+					e->sp += 2;
+				}
+			}
+			if(n & 4)
+			{
+				e->psw = rd8(e, 0, e->sp);
+				e->sp += 2;
+				irq_recheck(e);
+			}
+			if(n & 2)
+			{
+				next = rd16(e, 0, e->sp);
+				e->sp += 2;
+				if(e->large)
+				{
+					e->csr = rd16(e, 0, e->sp) & 0xf;
+					e->sp += 2;
+				}
+			}
+			break;
+
+		// coprocessor - register file only
+		case U8_MOV_CR_R:
+			e->cr[n] = e->r[m]; break;
+		case U8_MOV_R_CR:
+			e->r[n] = e->cr[m]; break;
+		case U8_MOV_CR_EA:
+		case U8_MOV_CR_EAP:
+			e->cr[n] = rd8(e, data_seg(e, ent), e->ea);
+			if(t == U8_MOV_CR_EAP)
+				e->ea += 1;
+			break;
+		case U8_MOV_EA_CR:
+		case U8_MOV_EAP_CR:
+			wr8(e, data_seg(e, ent), e->ea, e->cr[n]);
+			if(t == U8_MOV_EAP_CR)
+				e->ea += 1;
+			break;
+		case U8_MOV_CER_EA:
+		case U8_MOV_CER_EAP:
+		case U8_MOV_CXR_EA:
+		case U8_MOV_CXR_EAP:
+		case U8_MOV_CQR_EA:
+		case U8_MOV_CQR_EAP:
+			i = (t == U8_MOV_CER_EA || t == U8_MOV_CER_EAP) ? 2 :
+				(t == U8_MOV_CXR_EA || t == U8_MOV_CXR_EAP) ? 4 : 8;
+			rd_regs(e, data_seg(e, ent), e->ea, &e->cr[n & ~(i - 1)], i);
+			if(t == U8_MOV_CER_EAP || t == U8_MOV_CXR_EAP || t == U8_MOV_CQR_EAP)
+				e->ea += i;
+			break;
+		case U8_MOV_EA_CER:
+		case U8_MOV_EAP_CER:
+		case U8_MOV_EA_CXR:
+		case U8_MOV_EAP_CXR:
+		case U8_MOV_EA_CQR:
+		case U8_MOV_EAP_CQR:
+			i = (t == U8_MOV_EA_CER || t == U8_MOV_EAP_CER) ? 2 :
+				(t == U8_MOV_EA_CXR || t == U8_MOV_EAP_CXR) ? 4 : 8;
+			wr_regs(e, data_seg(e, ent), e->ea, &e->cr[n & ~(i - 1)], i);
+			if(t == U8_MOV_EAP_CER || t == U8_MOV_EAP_CXR || t == U8_MOV_EAP_CQR)
+				e->ea += i;
+			break;
+
+		// EA
+		case U8_LEA_ER:
+			e->ea = ER(n); break;
+		case U8_LEA_D16_ER:
+			e->ea = ER(n) + ent->s_word; break;
+		case U8_LEA_DA:
+			e->ea = ent->s_word; break;
+
+		// decimal adjust, negate
+		case U8_DAA_R:
+		case U8_DAS_R:
+			b = 0;
+			if((e->psw & U8_PSW_HC) || (e->r[n] & 0xf) > 9)
+				b |= 0x06;
+			if((e->psw & U8_PSW_C) || e->r[n] > 0x99)
+				b |= 0x60;
+			v = (t == U8_DAA_R) ? e->r[n] + b : e->r[n] - b;
+			set_flags(e, fm, flags_zs8(v) | (b & 0x60 ? U8_PSW_C : 0) |
+				(((t == U8_DAA_R) ? (e->r[n] & 0xf) + (b & 0xf) > 0xf : (e->r[n] & 0xf) < (b & 0xf)) ? U8_PSW_HC : 0));
+			e->r[n] = v;
+			break;
+		case U8_NEG_R:
+			e->r[n] = alu_sub8(e, fm, 0, e->r[n], 0, 0); break;
+
+		// bit access - Z is the old bit, inverted
+		case U8_SB_R:
+		case U8_RB_R:
+		case U8_TB_R:
+			set_flags(e, fm, (e->r[n] >> m) & 1 ? 0 : U8_PSW_Z);
+			if(t == U8_SB_R)
+				e->r[n] |= 1 << m;
+			else if(t == U8_RB_R)
+				e->r[n] &= ~(1 << m);
+			break;
+		case U8_SB_DBIT:
+		case U8_RB_DBIT:
+		case U8_TB_DBIT:
+			seg = data_seg(e, ent);
+			b = rd8(e, seg, ent->s_word);
+			set_flags(e, fm, (b >> n) & 1 ? 0 : U8_PSW_Z);
+			if(t == U8_SB_DBIT)
+				wr8(e, seg, ent->s_word, b | (1 << n));
+			else if(t == U8_RB_DBIT)
+				wr8(e, seg, ent->s_word, b & ~(1 << n));
+			break;
+
+		// PSW
+		case U8_EI:
+			e->psw |= U8_PSW_MIE;
+			irq_recheck(e);
+			break;
+		case U8_DI:
+			e->psw &= ~U8_PSW_MIE; break;
+		case U8_SC:
+			e->psw |= U8_PSW_C; break;
+		case U8_RC:
+			e->psw &= ~U8_PSW_C; break;
+		case U8_CPLC:
+			e->psw ^= U8_PSW_C; break;
+
+		// relative branches, in words from the next instruction
+		case U8_BGE_RAD:
+		case U8_BLT_RAD:
+		case U8_BGT_RAD:
+		case U8_BLE_RAD:
+		case U8_BGES_RAD:
+		case U8_BLTS_RAD:
+		case U8_BGTS_RAD:
+		case U8_BLES_RAD:
+		case U8_BNE_RAD:
+		case U8_BEQ_RAD:
+		case U8_BNV_RAD:
+		case U8_BOV_RAD:
+		case U8_BPS_RAD:
+		case U8_BNS_RAD:
+		case U8_BAL_RAD:
+			if(branch_taken(e, t))
+				next = e->pc + 2 + (st8)n * 2;
+			break;
+
+		case U8_EXTBW_ER:
+			e->r[(m & 0xe) + 1] = (e->r[m & 0xe] & 0x80) ? 0xff : 0;
+			set_flags(e, fm, flags_zs16(ER(m)));
+			break;
+
+		// software interrupt - vector table at 0x80 in segment 0
+		case U8_SWI_O:
+			e->elr[1] = next;
+			e->ecsr[1] = e->csr;
+			e->epsw[1] = e->psw;
+			e->psw = (e->psw & ~(U8_PSW_MIE | U8_PSW_ELEVEL)) | 1;
+			e->csr = 0;
+			next = rom16(e, 0x80 + n * 2);
+			break;
+		case U8_BRK:
+			return U8_EMU_BRK;
+
+		// branches
+		case U8_BL_AD:
+			e->lr = next;
+			e->lcsr = e->csr;
+			// fall through
+		case U8_B_AD:
+			e->csr = n;
+			next = ent->s_word;
+			break;
+		case U8_BL_ER:
+			e->lr = next;
+			e->lcsr = e->csr;
+			// fall through
+		case U8_B_ER:
+			next = ER(n);
+			break;
+
+		case U8_MUL_ER:
+			v = e->r[n & 0xe] * e->r[m];
+			set_er(e, n, v);
+			set_flags(e, fm, v ? 0 : U8_PSW_Z);
+			break;
+		case U8_DIV_ER:
+			v = ER(n);
+			if(e->r[m])
+			{
+				b = v % e->r[m];
+				v /= e->r[m];
+				set_flags(e, fm, v ? 0 : U8_PSW_Z);
+			}
+			else
+			{
+				b = e->r[n & 0xe];
+				v = 0xffff;
+				set_flags(e, fm, U8_PSW_C);
+			}
+			set_er(e, n, v);
+			e->r[m] = b;
+			break;
+
+		case U8_INC_EA:
+			seg = data_seg(e, ent);
+			wr8(e, seg, e->ea, alu_add8(e, fm, rd8(e, seg, e->ea), 1, 0, 0));
+			break;
+		case U8_DEC_EA:
+			seg = data_seg(e, ent);
+			wr8(e, seg, e->ea, alu_sub8(e, fm, rd8(e, seg, e->ea), 1, 0, 0));
+			break;
+
+		case U8_RT:
+			next = e->lr;
+			e->csr = e->lcsr;
+			break;
+		case U8_RTI:
+			i = ELEVEL;
+			next = e->elr[i];
+			e->csr = e->ecsr[i];
+			e->psw = e->epsw[i];
+			irq_recheck(e);
+			break;
+		case U8_NOP:
+			break;
+
+		default:			// U8_ILL, lone DSR prefix
+			return U8_EMU_ILL;
+	}
+
+	e->pc = next;
+	return -1;
+}
+
+// Event scheduling. Events sit in a min-heap ordered by instruction count
+// and insertion order, and the run loop compares icount against the
+// earliest of them once per block rather than polling every instruction.
+// Blocks that would run past an event are single stepped, and a handler
+// that schedules an event or requests an interrupt from inside a block
+// (SFR access) makes the block stop after the current instruction. Events
+// fire at the same instruction however blocks were translated, so runs
+// repeat exactly.
+//
+static inline int ev_before(const struct u8_emu_event *a, const struct u8_emu_event *b)
+{
+	return a->when < b->when || (a->when == b->when && a->seq < b->seq);
+}
+
+static void ev_up(struct u8_emu *e, int i)
+{
+	struct u8_emu_event t = e->ev[i];
+	int up;
+
+	for(; i > 0 && ev_before(&t, &e->ev[up = (i - 1) / 2]); i = up)
+		e->ev[i] = e->ev[up];
+	e->ev[i] = t;
+}
+
+static void ev_down(struct u8_emu *e, int i)
+{
+	struct u8_emu_event t = e->ev[i];
+	int c;
+
+	while((c = 2 * i + 1) < e->nev)
+	{
+		if(c + 1 < e->nev && ev_before(&e->ev[c + 1], &e->ev[c]))
+			c++;
+		if(!ev_before(&e->ev[c], &t))
+			break;
+		e->ev[i] = e->ev[c];
+		i = c;
+	}
+	e->ev[i] = t;
+}
+
+static void ev_remove(struct u8_emu *e, int i)
+{
+	if(--e->nev == i)
+		return;
+	e->ev[i] = e->ev[e->nev];
+	ev_up(e, i);
+	ev_down(e, i);
+}
+
+static void ev_insert(struct u8_emu *e, struct u8_emu_event *ev)
+{
+	ev->seq = e->ev_seq++;
+	e->ev[e->nev] = *ev;
+	ev_up(e, e->nev++);
+
+	// from an SFR handler in a block running past it - see NEXT_MEM
+	if(ev->when < e->ev_next)
+	{
+		e->ev_next = ev->when;
+		if(e->cur && ev->when < e->icount + e->cur->left)
+			e->resched = 1;
+	}
+}
+
+// interrupt through vector 'vec': state to the exception level's backup
+// registers, as swi does
+static void irq_take(struct u8_emu *e, int vec, int level)
+{
+	e->elr[level] = e->pc;
+	e->ecsr[level] = e->csr;
+	e->epsw[level] = e->psw;
+	e->psw = (e->psw & ~U8_PSW_ELEVEL) | level;
+	if(level == 1)
+		e->psw &= ~U8_PSW_MIE;
+	e->csr = 0;
+	e->pc = rom16(e, vec);
+	e->irq &= ~(1ULL << (vec >> 1));
+}
+
+// between instructions once icount reaches ev_next: fire the events due,
+// then take the highest priority interrupt that is enabled
+static void emu_service(struct u8_emu *e)
+{
+	struct u8_emu_event ev;
+	ut64 mask;
+
+	while(e->nev && e->ev[0].when <= e->icount)
+	{
+		ev = e->ev[0];
+		ev_remove(e, 0);
+		if(ev.period)
+		{
+			ev.when += ev.period;
+			ev_insert(e, &ev);
+		}
+		if(ev.vec)
+			e->irq |= 1ULL << (ev.vec >> 1);
+		if(ev.fn)
+			ev.fn(e, ev.id, ev.arg);
+	}
+
+	// NMI first, then the lowest maskable vector
+	if(e->irq && ELEVEL < 2)
+	{
+		mask = e->irq & ~(1ULL << (U8_EMU_VEC_NMI >> 1));
+		if(e->irq & (1ULL << (U8_EMU_VEC_NMI >> 1)))
+			irq_take(e, U8_EMU_VEC_NMI, 2);
+		else if(mask && (e->psw & U8_PSW_MIE))
+			irq_take(e, __builtin_ctzll(mask) * 2, 1);
+	}
+
+	e->resched = 0;
+	e->ev_next = e->nev ? e->ev[0].when : UINT64_MAX;
+}
+
+// Schedule event 'id' for instruction count 'when', replacing any event
+// with the same id. It requests interrupt 'vec' if not 0 and calls fn if
+// set, again every 'period' instructions if not 0. Callable from event and
+// SFR handlers.
+//	returns -1 if the queue is full
+int u8_emu_event_add(struct u8_emu *e, int id, ut64 when, ut32 period, int vec,
+	u8_emu_event_fn fn, void *arg)
+{
+	struct u8_emu_event ev;
+
+	u8_emu_event_del(e, id);
+	if(e->nev == U8_EMU_EVENTS)
+		return -1;
+
+	ev.when = when;
+	ev.period = period;
+	ev.id = id;
+	ev.vec = vec;
+	ev.fn = fn;
+	ev.arg = arg;
+	ev_insert(e, &ev);
+	return 0;
+}
+
+void u8_emu_event_del(struct u8_emu *e, int id)
+{
+	int i;
+
+	for(i=0; i<e->nev; i++)
+	{
+		if(e->ev[i].id == id)
+		{
+			ev_remove(e, i);
+			break;
+		}
+	}
+}
+
+// timer requesting interrupt 'vec' every 'period' instructions from now
+//	returns -1 if the queue is full
+int u8_emu_timer(struct u8_emu *e, int id, ut32 period, int vec)
+{
+	if(!period)
+		return -1;
+	return u8_emu_event_add(e, id, e->icount + period, period, vec, NULL, NULL);
+}
+
+// request interrupt 'vec' (U8_EMU_VEC_..); taken before the next
+// instruction if enabled, otherwise once it is
+void u8_emu_irq(struct u8_emu *e, int vec)
+{
+	if(vec < U8_EMU_VEC_NMI || vec > 0x7e)
+		return;
+	e->irq |= 1ULL << (vec >> 1);
+	e->ev_next = 0;
+	e->resched = 1;
+}
+
+// next instruction of the block, or back to the block loop after its last
+#define NEXT \
+	do { \
+		e->pc += ent->len; \
+		if(ent->left == 1) \
+			goto block; \
+		ent += ent->len >> 1; \
+		goto *ent->code; \
+	} while(0)
+
+// NEXT for handlers that access data memory: an SFR handler may have moved
+// the next event into this block - leave it after this instruction
+#define NEXT_MEM \
+	do { \
+		if(e->resched) \
+		{ \
+			e->pc += ent->len; \
+			BLOCK_EXIT; \
+		} \
+		NEXT; \
+	} while(0)
+
+// give back the instructions counted up front for the rest of the block
+#define BLOCK_EXIT \
+	do { \
+		e->icount -= ent->left - 1; \
+		n -= ent->left - 1; \
+		e->resched = 0; \
+		goto block; \
+	} while(0)
+
+// on to the second instruction of a fused pair
+#define FUSED(label) \
+	do { \
+		e->pc += ent->len; \
+		ent += ent->len >> 1; \
+		goto label; \
+	} while(0)
+
+// run until 'max' instructions, the 'until' code address (CSR:PC), or a
+// brk/undefined instruction/fetch fault
+//
+// Blocks run as direct threaded code: each entry holds the address of its
+// handler and handlers jump straight to the next one. A block is only
+// entered this way if it will run to its end; otherwise instructions are
+// executed one at a time through emu_exec() with all flags computed.
+// Traced runs go by block too, every entry on h_traced.
+int u8_emu_run(struct u8_emu *e, ut64 max, ut32 until)
+{
+	static const void *const handlers[H_NUM] =
+	{
+		[H_GENERIC] = &&h_generic,
+		[H_ADD_R] = &&h_add_r, [H_ADD_O] = &&h_add_o,
+		[H_ADDC_R] = &&h_addc_r, [H_SUB_R] = &&h_sub_r,
+		[H_MOV_R] = &&h_mov_r, [H_MOV_O] = &&h_mov_o,
+		[H_CMP_R] = &&h_cmp_r, [H_CMP_O] = &&h_cmp_o,
+		[H_ADD_ER] = &&h_add_er, [H_ADD_ER_O] = &&h_add_er_o,
+		[H_CMP_ER] = &&h_cmp_er, [H_MOV_ER] = &&h_mov_er,
+		[H_MOV_ER_O] = &&h_mov_er_o, [H_ADD_SP_O] = &&h_add_sp_o,
+		[H_L_R_EAP] = &&h_l_r_eap, [H_ST_R_EAP] = &&h_st_r_eap,
+		[H_L_ER_D6_FP] = &&h_l_er_d6_fp, [H_ST_ER_D6_FP] = &&h_st_er_d6_fp,
+		[H_PUSH_ER] = &&h_push_er, [H_POP_ER] = &&h_pop_er,
+		[H_BCC] = &&h_bcc, [H_BL_AD] = &&h_bl_ad, [H_RT] = &&h_rt,
+		[H_CMP_R_BCC] = &&h_cmp_r_bcc, [H_CMP_O_BCC] = &&h_cmp_o_bcc,
+		[H_PUSH_LR_ADD_SP] = &&h_push_lr_add_sp,
+		[H_TRACED] = &&h_traced,
+	};
+	struct u8_emu_ent *ent;
+	ut64 n=0;
+	ut32 addr;
+	ut16 v;
+	int ret;
+
+block:
+	e->cur = NULL;
+	if(n >= max)
+		return U8_EMU_LIMIT;
+	if(e->icount >= e->ev_next)
+		emu_service(e);
+	addr = CODE_ADDR;
+	if(addr == until)
+		return U8_EMU_UNTIL;
+	if(addr + 1 >= e->rom_size)
+		return U8_EMU_FAULT;
+
+	ent = &e->icache[addr >> 1];
+	if(!ent_len(ent) && !(ent = emu_translate_shared(e, addr, handlers)))
+		return U8_EMU_FAULT;
+
+	if(e->cov && !(e->cov[addr >> 4] & (1 << ((addr >> 1) & 7))))
+	{
+		e->cov[addr >> 4] |= 1 << ((addr >> 1) & 7);
+		e->cov_list[e->cov_count++] = addr;
+	}
+
+	// the run could stop or an event fire inside the block (at most 6
+	// bytes per instruction) - single step it with exact flags
+	if(ent->left > max - n || until - addr < ent->left * 6U || ent->left > e->ev_next - e->icount)
+	{
+		if((ret = emu_exec(e, ent, flags_mask(ent->type))) >= 0)
+			return ret;
+		if(e->trace)
+			u8_trace_insn(e->trace, e, addr, ent->type);
+		e->icount++;
+		n++;
+		goto block;
+	}
+
+	// counted up front, taken back if an instruction stops the run
+	n += ent->left;
+	e->icount += ent->left;
+	goto *ent->code;
+
+h_generic:
+	e->cur = ent;
+	if((ret = emu_exec(e, ent, ent->fmask)) >= 0)
+	{
+		e->icount -= ent->left;
+		e->cur = NULL;
+		return ret;
+	}
+	if(e->resched)
+		BLOCK_EXIT;
+	if(ent->left == 1)
+		goto block;
+	ent += ent->len >> 1;
+	goto *ent->code;
+
+h_traced:
+	addr = CODE_ADDR;
+	e->cur = ent;
+	if((ret = emu_exec(e, ent, ent->fmask)) >= 0)
+	{
+		e->icount -= ent->left;
+		e->cur = NULL;
+		return ret;
+	}
+	u8_trace_insn(e->trace, e, addr, ent->type);
+	if(e->resched)
+		BLOCK_EXIT;
+	if(ent->left == 1)
+		goto block;
+	ent += ent->len >> 1;
+	goto *ent->code;
+
+h_add_r:
+	e->r[ent->op1] = alu_add8(e, ent->fmask, e->r[ent->op1], e->r[ent->op2], 0, 0);
+	NEXT;
+h_add_o:
+	e->r[ent->op1] = alu_add8(e, ent->fmask, e->r[ent->op1], ent->op2, 0, 0);
+	NEXT;
+h_addc_r:
+	e->r[ent->op1] = alu_add8(e, ent->fmask, e->r[ent->op1], e->r[ent->op2], (e->psw & U8_PSW_C) != 0, 1);
+	NEXT;
+h_sub_r:
+	e->r[ent->op1] = alu_sub8(e, ent->fmask, e->r[ent->op1], e->r[ent->op2], 0, 0);
+	NEXT;
+h_mov_r:
+	set_flags(e, ent->fmask, flags_zs8(e->r[ent->op1] = e->r[ent->op2]));
+	NEXT;
+h_mov_o:
+	set_flags(e, ent->fmask, flags_zs8(e->r[ent->op1] = ent->op2));
+	NEXT;
+h_cmp_r:
+	alu_sub8(e, ent->fmask, e->r[ent->op1], e->r[ent->op2], 0, 0);
+	NEXT;
+h_cmp_o:
+	alu_sub8(e, ent->fmask, e->r[ent->op1], ent->op2, 0, 0);
+	NEXT;
+h_add_er:
+	set_er(e, ent->op1, alu_add16(e, ent->fmask, ER(ent->op1), ER(ent->op2)));
+	NEXT;
+h_add_er_o:
+	set_er(e, ent->op1, alu_add16(e, ent->fmask, ER(ent->op1), imm7(ent->op2)));
+	NEXT;
+h_cmp_er:
+	alu_sub16(e, ent->fmask, ER(ent->op1), ER(ent->op2));
+	NEXT;
+h_mov_er:
+	v = ER(ent->op2);
+	set_er(e, ent->op1, v);
+	set_flags(e, ent->fmask, flags_zs16(v));
+	NEXT;
+h_mov_er_o:
+	v = imm7(ent->op2);
+	set_er(e, ent->op1, v);
+	set_flags(e, ent->fmask, flags_zs16(v));
+	NEXT;
+h_add_sp_o:
+	e->sp += (st8)ent->op1;
+	NEXT;
+h_l_r_eap:
+	e->cur = ent;
+	set_flags(e, ent->fmask, flags_zs8(e->r[ent->op1] = rd8(e, 0, e->ea)));
+	e->ea++;
+	NEXT_MEM;
+h_st_r_eap:
+	e->cur = ent;
+	wr8(e, 0, e->ea, e->r[ent->op1]);
+	e->ea++;
+	NEXT_MEM;
+h_l_er_d6_fp:
+	e->cur = ent;
+	v = rd16(e, 0, ER(14) + disp6(ent->op2));
+	set_er(e, ent->op1, v);
+	set_flags(e, ent->fmask, flags_zs16(v));
+	NEXT_MEM;
+h_st_er_d6_fp:
+	e->cur = ent;
+	wr16(e, 0, ER(14) + disp6(ent->op2), ER(ent->op1));
+	NEXT_MEM;
+h_push_er:
+	e->cur = ent;
+	e->sp -= 2;
+	wr16(e, 0, e->sp, ER(ent->op1));
+	NEXT_MEM;
+h_pop_er:
+	e->cur = ent;
+	set_er(e, ent->op1, rd16(e, 0, e->sp));
+	e->sp += 2;
+	NEXT_MEM;
+
+h_bcc:
+	e->pc += 2;
+	if(branch_taken(e, ent->type))
+		e->pc += (st8)ent->op1 * 2;
+	goto block;
+h_bl_ad:
+	e->lr = e->pc + ent->len;
+	e->lcsr = e->csr;
+	e->csr = ent->op1;
+	e->pc = ent->s_word;
+	goto block;
+h_rt:
+	e->pc = e->lr;
+	e->csr = e->lcsr;
+	goto block;
+
+h_cmp_r_bcc:
+	alu_sub8(e, ent->fmask, e->r[ent->op1], e->r[ent->op2], 0, 0);
+	FUSED(h_bcc);
+h_cmp_o_bcc:
+	alu_sub8(e, ent->fmask, e->r[ent->op1], ent->op2, 0, 0);
+	FUSED(h_bcc);
+h_push_lr_add_sp:
+	e->cur = ent;
+	if(e->large)
+	{
+		e->sp -= 2;
+		wr16(e, 0, e->sp, e->lcsr);
+	}
+	e->sp -= 2;
+	wr16(e, 0, e->sp, e->lr);
+	if(e->resched)
+	{
+		e->pc += ent->len;
+		BLOCK_EXIT;
+	}
+	FUSED(h_add_sp_o);
+}
+
+int u8_emu_step(struct u8_emu *e)
+{
+	return u8_emu_run(e, 1, U8_EMU_NO_ADDR);
+}
+
+// call the routine at code address 'addr', as if by 'bl', and run until it
+// returns (U8_EMU_UNTIL) or stops for another reason. In the small model
+// 'pop pc' returns without restoring CSR, so the return address is
+// U8_EMU_RET_ADDR in segment 0 there.
+int u8_emu_call(struct u8_emu *e, ut32 addr, ut64 max)
+{
+	ut32 ret = e->large ? U8_EMU_RET_ADDR : U8_EMU_RET_ADDR & 0xffff;
+
+	e->lr = ret & 0xffff;
+	e->lcsr = ret >> 16;
+	e->csr = addr >> 16;
+	e->pc = addr;
+
+	return u8_emu_run(e, max, ret);
+}
+
+// SP and PC from the reset vectors, everything else cleared
+void u8_emu_reset(struct u8_emu *e)
+{
+	memset(e->r, 0, sizeof(e->r));
+	memset(e->elr, 0, sizeof(e->elr));
+	memset(e->ecsr, 0, sizeof(e->ecsr));
+	memset(e->epsw, 0, sizeof(e->epsw));
+	memset(e->cr, 0, sizeof(e->cr));
+	e->ea = e->lr = 0;
+	e->csr = e->lcsr = e->dsr = e->psw = 0;
+	e->sp = rom16(e, 0);
+	e->pc = rom16(e, 2);
+	e->icount = 0;
+
+	// peripherals reset too
+	e->nev = 0;
+	e->irq = 0;
+	e->ev_next = 0;
+}
+
+// set the type of the pages covering addr..addr+size-1 of data memory;
+// take any snapshot again afterwards
+//	returns -1 if the range is outside the 16M space
+int u8_emu_map(struct u8_emu *e, ut32 addr, ut32 size, int type)
+{
+	ut32 p, end;
+
+	if(!size || addr >= U8_EMU_DATA_SIZE || size > U8_EMU_DATA_SIZE - addr)
+		return -1;
+
+	end = PAGE(addr + size - 1);
+	for(p=PAGE(addr); p<=end; p++)
+	{
+		free(ram_page(e, p));
+		e->wr_page[p] = NULL;
+		e->sfr_map[p >> 3] &= ~(1 << (p & 7));
+		e->ram_map[p >> 3] &= ~(1 << (p & 7));
+
+		switch(type)
+		{
+			case U8_MEM_ROM:
+				// past the end of the image reads as erased flash
+				if(((p + 1) << U8_EMU_PAGE_BITS) <= e->rom_size)
+					e->rd_page[p] = e->rom + (p << U8_EMU_PAGE_BITS);
+				else if((p << U8_EMU_PAGE_BITS) < e->rom_size)
+					e->rd_page[p] = e->rom_tail;
+				else
+					e->rd_page[p] = erased_page;
+				break;
+			case U8_MEM_RAM:
+				e->rd_page[p] = zero_page;
+				e->ram_map[p >> 3] |= 1 << (p & 7);
+				break;
+			case U8_MEM_SFR:
+				e->rd_page[p] = NULL;
+				e->sfr_map[p >> 3] |= 1 << (p & 7);
+				break;
+		}
+	}
+	return 0;
+}
+
+// set up an emulator for a ROM image, with the default memory layout;
+// the ROM is used in place and must outlive the emulator
+//	returns -1 if out of memory
+int u8_emu_init(struct u8_emu *e, const ut8 *rom, ut32 rom_size)
+{
+	ut32 tail;
+
+	memset(e, 0, sizeof(*e));
+
+	if(rom_size > U8_EMU_CODE_MAX)
+		rom_size = U8_EMU_CODE_MAX;
+	e->rom = rom;
+	e->rom_size = rom_size & ~1;
+	e->large = rom_size > 0x10000;
+
+	e->icache = calloc(e->rom_size / 2 + 1, sizeof(*e->icache));
+	if(!e->icache)
+		return -1;
+
+	// last, partial page of the image, padded as erased flash
+	if((tail = PAGE_OFF(e->rom_size)))
+	{
+		if(!(e->rom_tail = malloc(U8_EMU_PAGE_SIZE)))
+		{
+			u8_emu_fini(e);
+			return -1;
+		}
+		memset(e->rom_tail, 0xff, U8_EMU_PAGE_SIZE);
+		memcpy(e->rom_tail, rom + e->rom_size - tail, tail);
+	}
+
+	u8_emu_map(e, 0, U8_EMU_DATA_SIZE, U8_MEM_RAM);
+	u8_emu_map(e, 0, U8_EMU_RAM_START, U8_MEM_ROM);
+	if(e->rom_size > 0x10000)
+		u8_emu_map(e, 0x10000, e->rom_size - 0x10000, U8_MEM_ROM);
+	u8_emu_map(e, U8_EMU_SFR_START, 0x10000 - U8_EMU_SFR_START, U8_MEM_SFR);
+
+	u8_emu_reset(e);
+	return 0;
+}
+
+// u8_emu_init() on an mmap of a ROM image file
+//	returns -1 if it cannot be mapped or out of memory
+int u8_emu_open(struct u8_emu *e, const char *path)
+{
+	struct stat st;
+	const ut8 *rom;
+	size_t size;
+	int fd;
+
+	if((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	if(fstat(fd, &st) < 0 || st.st_size < 2)
+	{
+		close(fd);
+		return -1;
+	}
+	size = st.st_size;
+	rom = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(rom == MAP_FAILED)
+		return -1;
+
+	if(u8_emu_init(e, rom, size) < 0)
+	{
+		munmap((void *)rom, size);
+		return -1;
+	}
+	e->map_size = size;
+	return 0;
+}
+
+void u8_emu_fini(struct u8_emu *e)
+{
+	int p;
+
+	for(p=0; p<U8_EMU_PAGES; p++)
+	{
+		free(ram_page(e, p));
+		e->wr_page[p] = NULL;
+		e->rd_page[p] = NULL;
+	}
+	free(e->cov);
+	free(e->cov_list);
+	e->cov = NULL;
+	e->cov_list = NULL;
+	u8_emu_trace_stop(e);
+
+	// a clone shares the rest
+	if(!e->clone)
+	{
+		free(e->icache);
+		free(e->rom_tail);
+		if(e->map_size)
+			munmap((void *)e->rom, e->map_size);
+	}
+	e->icache = NULL;
+	e->rom_tail = NULL;
+	e->map_size = 0;
+}
+
+// Another emulator on the same ROM and decode cache, with its own copy of
+// the registers and RAM. Translation into the shared cache is serialized
+// through src->lock, which must be set before cloning if the emulators run
+// on different threads. 'src' must outlive the clone.
+//	returns -1 if out of memory
+int u8_emu_clone(struct u8_emu *e, struct u8_emu *src)
+{
+	ut8 *page;
+	ut32 p;
+
+	memcpy(e, src, sizeof(*e));
+	if(src->trace)				// not its traced blocks
+		e->icache = u8_trace_icache(src->trace);
+	e->clone = 1;
+	e->snap = NULL;
+	e->ndirty = 0;
+	e->cov = NULL;
+	e->cov_list = NULL;
+	e->cov_count = 0;
+	e->trace = NULL;
+
+	for(p=0; p<U8_EMU_PAGES; p++)
+	{
+		e->wr_page[p] = NULL;
+		if(!(page = ram_page(src, p)))
+			continue;
+		if(!(e->wr_page[p] = malloc(U8_EMU_PAGE_SIZE)))
+		{
+			e->rd_page[p] = zero_page;
+			u8_emu_fini(e);
+			return -1;
+		}
+		memcpy(e->wr_page[p], page, U8_EMU_PAGE_SIZE);
+		e->rd_page[p] = e->wr_page[p];
+	}
+	return 0;
+}
+
+// data memory access from outside the emulator, SFR handlers included
+ut8 u8_emu_read8(struct u8_emu *e, ut32 addr)
+{
+	return rd8(e, addr >> 16, addr);
+}
+
+void u8_emu_write8(struct u8_emu *e, ut32 addr, ut8 v)
+{
+	struct u8_trace *t = e->trace;
+
+	// not an instruction's write
+	e->trace = NULL;
+	wr8(e, addr >> 16, addr, v);
+	e->trace = t;
+}
+
+// Snapshots. Taking one copies the CPU registers, the SFR backing and every
+// RAM page written so far, then drops the write pointers of the RAM pages
+// so the first write to each goes through wr_slow() and lands on the dirty
+// list. Restoring the latest snapshot only copies back the dirty pages.
+
+// stop tracking writes against the current snapshot
+static void snap_untrack(struct u8_emu *e)
+{
+	ut32 p;
+
+	for(p=0; p<U8_EMU_PAGES; p++)
+		e->wr_page[p] = ram_page(e, p);
+	e->ndirty = 0;
+	e->snap = NULL;
+}
+
+// track writes against 's' from now on
+static void snap_track(struct u8_emu *e, struct u8_emu_snap *s)
+{
+	ut32 p;
+
+	for(p=0; p<U8_EMU_PAGES; p++)
+		if(IS_RAM(e, p))
+			e->wr_page[p] = NULL;
+	e->ndirty = 0;
+	e->snap = s;
+}
+
+//	returns NULL if out of memory
+struct u8_emu_snap *u8_emu_snap_take(struct u8_emu *e)
+{
+	struct u8_emu_snap *s;
+	ut8 *page;
+	ut32 p;
+
+	if(!(s = calloc(1, sizeof(*s))))
+		return NULL;
+	for(p=0; p<U8_EMU_PAGES; p++)
+	{
+		if(!(page = ram_page(e, p)))
+			continue;
+		if(!(s->page[p] = malloc(U8_EMU_PAGE_SIZE)))
+		{
+			u8_emu_snap_free(e, s);
+			return NULL;
+		}
+		memcpy(s->page[p], page, U8_EMU_PAGE_SIZE);
+	}
+	memcpy(s->regs, e, U8_EMU_REGS_SIZE);
+	memcpy(s->sfr, e->sfr, sizeof(s->sfr));
+	memcpy(s->ev, e->ev, e->nev * sizeof(*e->ev));
+	s->nev = e->nev;
+	s->ev_seq = e->ev_seq;
+	s->irq = e->irq;
+	s->icount = e->icount;
+
+	snap_track(e, s);
+	return s;
+}
+
+// back to the state of 's' - cheap for the latest snapshot, a copy of all
+// RAM for an older one
+void u8_emu_snap_restore(struct u8_emu *e, struct u8_emu_snap *s)
+{
+	ut8 *page;
+	ut32 p;
+	int i;
+
+	if(e->snap == s)
+	{
+		for(i=0; i<e->ndirty; i++)
+		{
+			p = e->dirty[i];
+			if(s->page[p])
+				memcpy(e->wr_page[p], s->page[p], U8_EMU_PAGE_SIZE);
+			else
+				memset(e->wr_page[p], 0, U8_EMU_PAGE_SIZE);
+			e->wr_page[p] = NULL;
+		}
+		e->ndirty = 0;
+	}
+	else
+	{
+		snap_untrack(e);
+		for(p=0; p<U8_EMU_PAGES; p++)
+		{
+			if(s->page[p] && e->rd_page[p] == zero_page)
+				wr_slow(e, p << U8_EMU_PAGE_BITS, 0);	// allocate it
+			if((page = ram_page(e, p)))
+			{
+				if(s->page[p])
+					memcpy(page, s->page[p], U8_EMU_PAGE_SIZE);
+				else
+					memset(page, 0, U8_EMU_PAGE_SIZE);
+			}
+		}
+		snap_track(e, s);
+	}
+
+	memcpy(e, s->regs, U8_EMU_REGS_SIZE);
+	memcpy(e->sfr, s->sfr, sizeof(e->sfr));
+	memcpy(e->ev, s->ev, s->nev * sizeof(*e->ev));
+	e->nev = s->nev;
+	e->ev_seq = s->ev_seq;
+	e->irq = s->irq;
+	e->ev_next = 0;
+	e->resched = 0;
+	e->icount = s->icount;
+}
+
+void u8_emu_snap_free(struct u8_emu *e, struct u8_emu_snap *s)
+{
+	ut32 p;
+
+	if(!s)
+		return;
+	if(e->snap == s)
+		snap_untrack(e);
+	for(p=0; p<U8_EMU_PAGES; p++)
+		free(s->page[p]);
+	free(s);
+}
+
+// Coverage: code addresses where execution entered a block (or was single
+// stepped), as a bitmap by code word plus the list of addresses hit.
+//	returns -1 if out of memory
+int u8_emu_cov_enable(struct u8_emu *e)
+{
+	if(e->cov)
+		return 0;
+	e->cov = calloc(1, e->rom_size / 16 + 1);
+	e->cov_list = malloc((e->rom_size / 2) * sizeof(*e->cov_list));
+	if(!e->cov || !e->cov_list)
+	{
+		free(e->cov);
+		free(e->cov_list);
+		e->cov = NULL;
+		e->cov_list = NULL;
+		return -1;
+	}
+	e->cov_count = 0;
+	return 0;
+}
+
+// forget the addresses hit, clearing only their bits
+void u8_emu_cov_clear(struct u8_emu *e)
+{
+	ut32 i, a;
+
+	for(i=0; i<e->cov_count; i++)
+	{
+		a = e->cov_list[i];
+		e->cov[a >> 4] &= ~(1 << ((a >> 1) & 7));
+	}
+	e->cov_count = 0;
+}
+
+// Run the routine at 'addr' once per input 0..n-1, each from snapshot 's'
+// with fresh coverage: input() sets up registers and memory for the run,
+// result() sees the state and coverage after it, and can end the loop by
+// returning non-zero. Coverage is enabled if it was not.
+//	returns the number of runs done, or -1 if out of memory
+int u8_emu_fuzz(struct u8_emu *e, struct u8_emu_snap *s, ut32 addr, ut64 max, int n,
+	void (*input)(struct u8_emu *e, int i, void *arg),
+	int (*result)(struct u8_emu *e, int i, int stop, void *arg), void *arg)
+{
+	int i, stop;
+
+	if(u8_emu_cov_enable(e) < 0)
+		return -1;
+
+	for(i=0; i<n; )
+	{
+		u8_emu_snap_restore(e, s);
+		u8_emu_cov_clear(e);
+		if(input)
+			input(e, i, arg);
+		stop = u8_emu_call(e, addr, max);
+		i++;
+		if(result && result(e, i - 1, stop, arg))
+			break;
+	}
+	u8_emu_snap_restore(e, s);
+
+	return i;
+}
+
+// Self-checks run by u8_bench, for cases random differential runs are
+// unlikely to hit; each returns its number of failures, -1 if out of
+// memory.
+
+// word stores (push er0, push er2, st er0) into RAM pages a snapshot
+// tracks - one page clean, one written before the snapshot - then back to
+// the snapshot, by block and by single steps
+static int check_snap(void)
+{
+	static const ut16 code[] = {0xf05e, 0xf25e, 0x9013, 0x9100, 0xffff};
+	struct u8_emu *e;
+	struct u8_emu_snap *s;
+	ut8 rom[0x40];
+	int i, k, bad=0;
+
+	memset(rom, 0xff, sizeof(rom));
+	r_write_at_le16(rom, 0x9000, 0);		// SP
+	r_write_at_le16(rom, 0x0010, 2);		// reset PC
+	for(i=0; i<5; i++)
+		r_write_at_le16(rom, code[i], 0x10 + i*2);
+
+	if(!(e = malloc(sizeof(*e))))
+		return -1;
+	if(u8_emu_init(e, rom, sizeof(rom)) < 0)
+	{
+		free(e);
+		return -1;
+	}
+	u8_emu_reset(e);
+	e->r[0] = 0x34;
+	e->r[1] = 0x12;
+	u8_emu_write8(e, 0x9100, 0x11);
+	if(!(s = u8_emu_snap_take(e)))
+	{
+		u8_emu_fini(e);
+		free(e);
+		return -1;
+	}
+
+	for(i=0; i<8; i++)
+	{
+		if(i & 1)
+		{
+			for(k=0; k<3; k++)
+				u8_emu_step(e);
+		}
+		else if(u8_emu_run(e, 10, U8_EMU_NO_ADDR) != U8_EMU_BRK)
+			bad++;
+		if(e->ndirty != 2 || u8_emu_read8(e, 0x8ffe) != 0x34 || u8_emu_read8(e, 0x9101) != 0x12)
+			bad++;
+
+		u8_emu_snap_restore(e, s);
+		if(e->ndirty || e->sp != 0x9000 || e->pc != 0x10 ||
+			u8_emu_read8(e, 0x8ffe) || u8_emu_read8(e, 0x9100) != 0x11 || u8_emu_read8(e, 0x9101))
+			bad++;
+	}
+
+	u8_emu_snap_free(e, s);
+	u8_emu_fini(e);
+	free(e);
+	return bad;
+}
+
+// code straddling the end of segment 0 in an image with a segment 1:
+// 'l er2, 0104h' at 0:fffe takes its address word from 0:0000 and then
+// runs on at 0:0002, as PC wraps - never into segment 1
+static int check_wrap(void)
+{
+	struct u8_emu *e;
+	ut8 *rom;
+	int i, bad=0;
+
+	if(!(rom = malloc(0x20000)))
+		return -1;
+	memset(rom, 0xff, 0x20000);
+	r_write_at_le16(rom, 0x0104, 0x0000);		// address word, also mov r1, #4
+	r_write_at_le16(rom, 0x5678, 0x0104);		// loaded through the ROM window
+	r_write_at_le16(rom, 0x0001, 0xfffc);		// mov r0, #1
+	r_write_at_le16(rom, 0x9212, 0xfffe);		// l er2, Dadr
+	r_write_at_le16(rom, 0x0108, 0x10000);		// wrong address word, mov r1, #8
+	r_write_at_le16(rom, 0x1111, 0x0108);
+
+	if(!(e = malloc(sizeof(*e))))
+	{
+		free(rom);
+		return -1;
+	}
+	if(u8_emu_init(e, rom, 0x20000) < 0)
+	{
+		free(e);
+		free(rom);
+		return -1;
+	}
+	for(i=0; i<2; i++)
+	{
+		u8_emu_reset(e);
+		e->csr = 0;
+		e->pc = 0xfffc;
+		if(i)
+		{
+			u8_emu_step(e);
+			u8_emu_step(e);
+			if(u8_emu_step(e) != U8_EMU_BRK)
+				bad++;
+		}
+		else if(u8_emu_run(e, 10, U8_EMU_NO_ADDR) != U8_EMU_BRK)
+			bad++;
+		if(e->csr || e->pc != 0x0002 || e->r[0] != 1 || e->r[1] ||
+			e->r[2] != 0x78 || e->r[3] != 0x56)
+			bad++;
+	}
+
+	u8_emu_fini(e);
+	free(e);
+	free(rom);
+	return bad;
+}
+
+//	returns number of failed checks, -1 if out of memory
+int u8_emu_check(void)
+{
+	int snap = check_snap(), wrap = check_wrap();
+
+	if(snap < 0 || wrap < 0)
+		return -1;
+	return snap + wrap;
+}
+
+// set a register by name (r0, er2, sp, pc, psw, ...)
+//	returns -1 for an unknown name
+int u8_emu_reg_set(struct u8_emu *e, const char *name, ut32 val)
+{
+	int n;
+
+	if(!strcmp(name, "pc"))
+	{
+		e->pc = val;
+		if(val > 0xffff)
+			e->csr = val >> 16;
+	}
+	else if(!strcmp(name, "sp"))
+		e->sp = val;
+	else if(!strcmp(name, "ea"))
+		e->ea = val;
+	else if(!strcmp(name, "lr"))
+		e->lr = val;
+	else if(!strcmp(name, "csr"))
+		e->csr = val & 0xf;
+	else if(!strcmp(name, "lcsr"))
+		e->lcsr = val & 0xf;
+	else if(!strcmp(name, "dsr"))
+		e->dsr = val;
+	else if(!strcmp(name, "psw"))
+	{
+		e->psw = val;
+		irq_recheck(e);
+	}
+	else if(sscanf(name, "er%d", &n) == 1 && n >= 0 && n < 16 && !(n & 1))
+		set_er(e, n, val);
+	else if(sscanf(name, "r%d", &n) == 1 && n >= 0 && n < 16)
+		e->r[n] = val;
+	else
+		return -1;
+
+	return 0;
+}
+
+const char *u8_emu_stop_name(int stop)
+{
+	switch(stop)
+	{
+		case U8_EMU_LIMIT:	return "limit";
+		case U8_EMU_UNTIL:	return "return";
+		case U8_EMU_BRK:	return "brk";
+		case U8_EMU_ILL:	return "illegal instruction";
+		case U8_EMU_FAULT:	return "fetch fault";
+	}
+	return "?";
+}
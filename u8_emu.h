@@ -0,0 +1,217 @@
+/* nX-U8/100 emulator - LGPL - Copyright 2020 - cetus9 */
+
+#ifndef U8_EMU_H
+#define U8_EMU_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <r_types.h>
+
+#include "u8_disas.h"
+
+// PSW bits
+#define U8_PSW_C		0x80	// carry
+#define U8_PSW_Z		0x40	// zero
+#define U8_PSW_S		0x20	// sign
+#define U8_PSW_OV		0x10	// overflow
+#define U8_PSW_MIE		0x08	// master interrupt enable
+#define U8_PSW_HC		0x04	// half carry
+#define U8_PSW_ELEVEL		0x03	// exception level
+
+// flags tracked by the dead flag pass
+#define U8_EMU_FLAGS		(U8_PSW_C | U8_PSW_Z | U8_PSW_S | U8_PSW_OV | U8_PSW_HC)
+
+#define U8_EMU_DATA_SIZE	0x1000000	// 256 segments of 64K
+#define U8_EMU_CODE_MAX		0x100000	// 16 segments of 64K
+
+// data memory pages
+#define U8_EMU_PAGE_BITS	12
+#define U8_EMU_PAGE_SIZE	(1 << U8_EMU_PAGE_BITS)
+#define U8_EMU_PAGES		(U8_EMU_DATA_SIZE >> U8_EMU_PAGE_BITS)
+
+// default segment 0 layout: ROM window, RAM, SFRs
+#define U8_EMU_RAM_START	0x8000
+#define U8_EMU_SFR_START	0xf000
+#define U8_EMU_BLOCK_MAX	32		// instructions per translated block
+#define U8_EMU_EVENTS		32		// scheduled events, at most
+
+// interrupt vectors (code addresses in segment 0 holding the handler)
+#define U8_EMU_VEC_NMI		0x08		// non-maskable, exception level 2
+#define U8_EMU_VEC_IRQ		0x0a		// first maskable one, up to 0x7e
+
+// code address returned to by u8_emu_call(), outside any real ROM; its
+// segment 0 part (fffeh) in the small model
+#define U8_EMU_RET_ADDR		0xffffe
+#define U8_EMU_NO_ADDR		0xffffffff
+
+// page types for u8_emu_map()
+enum
+{
+	U8_MEM_ROM,		// read from the image, writes ignored
+	U8_MEM_RAM,		// allocated on first write, reads 0 before that
+	U8_MEM_SFR,		// through the sfr_read/sfr_write handlers
+};
+
+// why u8_emu_run() stopped
+enum
+{
+	U8_EMU_LIMIT,		// instruction limit reached
+	U8_EMU_UNTIL,		// reached the 'until' address
+	U8_EMU_BRK,		// brk instruction, pc left on it
+	U8_EMU_ILL,		// undefined instruction, pc left on it
+	U8_EMU_FAULT,		// instruction fetch outside the ROM
+};
+
+// pre-decoded instruction, one per code word, filled a block at a time
+struct u8_emu_ent
+{
+	const void *code;	// threaded code handler in u8_emu_run()
+	ut8 type;		// U8_.. instruction type
+	ut8 len;		// length in bytes including any prefix, 0 if not decoded yet
+	ut8 pre;		// DSR prefix type (U8_PRE_..), or 0
+	ut8 pre_val;		// DSR prefix operand
+	ut8 fmask;		// PSW bits to compute: flags written and live
+	ut8 left;		// instructions to the end of the block, this one included
+	ut16 op1;
+	ut16 op2;
+	ut16 s_word;
+};
+
+struct u8_emu;
+struct u8_emu_snap;
+struct u8_trace;
+
+typedef void (*u8_emu_event_fn)(struct u8_emu *e, int id, void *arg);
+
+// Event at an instruction count - emulated time is counted in
+// instructions. Events due at the same count fire in the order they were
+// added.
+struct u8_emu_event
+{
+	ut64 when;		// fires before instruction number 'when' runs
+	ut64 seq;		// order among events due together
+	ut32 period;		// added again 'period' later, if not 0
+	int id;
+	int vec;		// interrupt to request, if not 0
+	u8_emu_event_fn fn;	// called, if set
+	void *arg;
+};
+
+struct u8_emu
+{
+	// CPU registers - first, saved as a block by snapshots
+	ut8 r[16];		// R0-R15, ERn/XRn/QRn are pairs of these
+	ut16 pc;
+	ut16 sp;
+	ut16 ea;
+	ut16 lr;
+	ut16 elr[4];		// ELR1-3, by ELEVEL
+	ut8 csr;		// code segment
+	ut8 lcsr;
+	ut8 ecsr[4];		// ECSR1-3
+	ut8 dsr;		// data segment
+	ut8 psw;
+	ut8 epsw[4];		// EPSW1-3
+	ut8 cr[16];		// coprocessor registers
+
+	int large;		// large memory model - CSR saved with return addresses
+
+	// memory
+	const ut8 *rom;		// code memory, CSR:PC
+	ut32 rom_size;
+	size_t map_size;	// length of the mmap if opened by u8_emu_open()
+	ut8 *rom_tail;		// copy of a partial last page of the image
+
+	// data memory, DSR:addr, by page: a NULL read pointer is an SFR page,
+	// a NULL write pointer an SFR, ROM or not yet allocated RAM page
+	const ut8 *rd_page[U8_EMU_PAGES];
+	ut8 *wr_page[U8_EMU_PAGES];
+	ut8 sfr_map[U8_EMU_PAGES / 8];	// SFR pages
+	ut8 ram_map[U8_EMU_PAGES / 8];	// RAM pages
+
+	// SFR access; when not set, reads and writes go to sfr[]
+	ut8 (*sfr_read)(struct u8_emu *e, ut32 addr);
+	void (*sfr_write)(struct u8_emu *e, ut32 addr, ut8 v);
+	ut8 sfr[U8_EMU_PAGE_SIZE];
+	void *user;
+
+	// events and interrupt requests; the run loop only looks at them when
+	// icount reaches ev_next
+	struct u8_emu_event ev[U8_EMU_EVENTS];	// min-heap on when, seq
+	int nev;
+	ut64 ev_seq;
+	ut64 ev_next;		// earliest event, 0 to look now
+	ut64 irq;		// requests pending, bit per vector word (vec / 2)
+	int resched;		// ev_next moved while running a block
+	const struct u8_emu_ent *cur;	// memory access in a threaded block, for SFR handlers
+
+	struct u8_emu_ent *icache;	// one per ROM word
+	ut64 icount;		// instructions executed
+	int clone;		// ROM and icache belong to another emulator
+	pthread_mutex_t *lock;	// translation lock if icache is shared by threads
+
+	// writes since the latest snapshot
+	struct u8_emu_snap *snap;
+	ut16 dirty[U8_EMU_PAGES];	// RAM pages written
+	int ndirty;
+
+	// coverage, if enabled
+	ut8 *cov;		// bit per code word
+	ut32 *cov_list;		// code addresses hit
+	ut32 cov_count;
+
+	struct u8_trace *trace;	// execution trace, if recording
+};
+
+#define U8_EMU_REGS_SIZE	offsetof(struct u8_emu, large)
+
+struct u8_emu_snap
+{
+	ut8 regs[U8_EMU_REGS_SIZE];
+	ut64 icount;
+	ut8 sfr[U8_EMU_PAGE_SIZE];
+	struct u8_emu_event ev[U8_EMU_EVENTS];
+	int nev;
+	ut64 ev_seq;
+	ut64 irq;
+	ut8 *page[U8_EMU_PAGES];	// RAM pages written at the time, NULL if still zero
+};
+
+int u8_emu_init(struct u8_emu *e, const ut8 *rom, ut32 rom_size);
+int u8_emu_open(struct u8_emu *e, const char *path);
+void u8_emu_fini(struct u8_emu *e);
+int u8_emu_clone(struct u8_emu *e, struct u8_emu *src);
+int u8_emu_map(struct u8_emu *e, ut32 addr, ut32 size, int type);
+ut8 u8_emu_read8(struct u8_emu *e, ut32 addr);
+void u8_emu_write8(struct u8_emu *e, ut32 addr, ut8 v);
+void u8_emu_reset(struct u8_emu *e);
+int u8_emu_run(struct u8_emu *e, ut64 max, ut32 until);
+int u8_emu_step(struct u8_emu *e);
+int u8_emu_call(struct u8_emu *e, ut32 addr, ut64 max);
+int u8_emu_reg_set(struct u8_emu *e, const char *name, ut32 val);
+int u8_emu_event_add(struct u8_emu *e, int id, ut64 when, ut32 period, int vec,
+	u8_emu_event_fn fn, void *arg);
+void u8_emu_event_del(struct u8_emu *e, int id);
+int u8_emu_timer(struct u8_emu *e, int id, ut32 period, int vec);
+void u8_emu_irq(struct u8_emu *e, int vec);
+const char *u8_emu_stop_name(int stop);
+
+struct u8_emu_snap *u8_emu_snap_take(struct u8_emu *e);
+void u8_emu_snap_restore(struct u8_emu *e, struct u8_emu_snap *s);
+void u8_emu_snap_free(struct u8_emu *e, struct u8_emu_snap *s);
+int u8_emu_cov_enable(struct u8_emu *e);
+void u8_emu_cov_clear(struct u8_emu *e);
+int u8_emu_trace_start(struct u8_emu *e, const char *path);
+int u8_emu_trace_stop(struct u8_emu *e);
+// batch job: set up inputs for job number 'job' on 'e', run, and return a
+// value to sum (u8_batch.c)
+typedef ut64 (*u8_emu_job_fn)(struct u8_emu *e, ut64 job, void *arg);
+
+st64 u8_emu_batch(struct u8_emu *proto, ut64 njobs, int nthreads, u8_emu_job_fn job, void *arg, ut64 *sum);
+int u8_batch_check(void);
+int u8_emu_fuzz(struct u8_emu *e, struct u8_emu_snap *s, ut32 addr, ut64 max, int n,
+	void (*input)(struct u8_emu *e, int i, void *arg),
+	int (*result)(struct u8_emu *e, int i, int stop, void *arg), void *arg);
+int u8_emu_check(void);
+
+#endif /* U8_EMU_H */
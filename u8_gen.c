@@ -0,0 +1,385 @@
+/* nX-U8/100 decoder table generator - LGPL - Copyright 2020 - cetus9 */
+
+// Host tool, run at build time. Derives decoder tables from u8inst[] so
+// that u8_insn.def stays the single source of truth for instruction encoding.
+//
+//	u8_gen lut	- emit u8_lut.c, a 64K opcode -> instruction type table
+//	u8_gen dtree	- emit u8_dtree.c, a nested switch over opcode nibbles
+//	u8_gen scan	- emit u8_scan.c, the plain first-match table walk
+//
+// Each emits a u8_decode_inst(); the Makefile picks one (U8_DECODER).
+//
+//	u8_gen nib	- emit u8_nib.c, nibble-pair tables for u8_classify()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "u8_disas.h"
+
+// reference decoder: first matching entry of the master table wins
+static int scan_inst(ut16 opcode)
+{
+	int i;
+
+	for(i=0; i<U8_INS_NUM; i++)
+	{
+		if((opcode & u8inst[i].ins_mask) == u8inst[i].ins)
+			return i;
+	}
+	return U8_ILL;
+}
+
+// fill 64K table by expanding each pattern over its don't-care bits
+//	table is walked backwards, so earlier (higher priority) entries
+//	overwrite later ones - same result as a first-match scan
+static void build_lut(ut8 *lut)
+{
+	int i;
+	ut16 free_bits, w;
+
+	memset(lut, U8_ILL, 0x10000);	// no match at all is 'dw'
+
+	for(i=U8_INS_NUM-1; i>=0; i--)
+	{
+		// skip patterns that can never match (bits set outside mask)
+		if(u8inst[i].ins & ~u8inst[i].ins_mask)
+			continue;
+
+		free_bits = ~u8inst[i].ins_mask;
+		w = 0;
+		do
+		{
+			lut[u8inst[i].ins | w] = i;
+			w = (w - free_bits) & free_bits;	// next subset of free bits
+		} while(w);
+	}
+}
+
+static int gen_lut(void)
+{
+	static ut8 lut[0x10000];
+	unsigned int w;
+
+	build_lut(lut);
+
+	// check against table scan for every possible first word
+	for(w=0; w<0x10000; w++)
+	{
+		if(lut[w] != scan_inst(w))
+		{
+			fprintf(stderr, "u8_gen: lut mismatch at %04xh (%d != %d)\n",
+				w, lut[w], scan_inst(w));
+			return 1;
+		}
+	}
+
+	printf("/* generated by u8_gen from u8_insn.def - do not edit */\n\n");
+	printf("#include \"u8_disas.h\"\n\n");
+	printf("const ut8 u8_lut[0x10000] =\n{");
+	for(w=0; w<0x10000; w++)
+		printf("%s%3d,", (w % 16) ? " " : "\n\t", lut[w]);
+	printf("\n};\n\n");
+
+	printf("// get instruction type (e.g. U8_MOV_..) for given opcode\n");
+	printf("int u8_decode_inst(ut16 opcode)\n{\n");
+	printf("\treturn u8_lut[opcode];\n}\n");
+
+	return 0;
+}
+
+// decision tree node: either a leaf (instruction type) or a switch on
+// one opcode nibble with 16 children
+struct dt_node
+{
+	int leaf;			// instruction type, or -1 for switch node
+	int nib;			// nibble switched on (0 = bits 3..0)
+	struct dt_node *kid[16];
+};
+
+// build tree for opcodes matching known bits (val under known mask)
+static struct dt_node *dt_build(ut16 val, ut16 known)
+{
+	struct dt_node *n;
+	int i, first=-1, nib, best=-1, score, best_score=-1;
+	int cand[U8_INS_NUM], ncand=0;
+
+	// collect entries still able to match, in priority order
+	for(i=0; i<U8_INS_NUM; i++)
+	{
+		if(u8inst[i].ins & ~u8inst[i].ins_mask)
+			continue;
+		if((val ^ u8inst[i].ins) & known & u8inst[i].ins_mask)
+			continue;
+		cand[ncand++] = i;
+	}
+
+	if(!(n = calloc(1, sizeof(*n))))
+	{
+		perror("u8_gen");
+		exit(1);
+	}
+	n->leaf = -1;
+
+	// no candidates left, or highest priority one fully decided
+	if(ncand == 0)
+		first = U8_ILL;
+	else if((u8inst[cand[0]].ins_mask & ~known) == 0)
+		first = cand[0];
+
+	if(first >= 0)
+	{
+		n->leaf = first;
+		return n;
+	}
+
+	// switch on the undecided nibble most candidates care about
+	for(nib=0; nib<4; nib++)
+	{
+		if(known & (0xf << (nib*4)))
+			continue;
+		score = 0;
+		for(i=0; i<ncand; i++)
+			score += __builtin_popcount(u8inst[cand[i]].ins_mask & (0xf << (nib*4)));
+		// favour the first candidate's nibbles to keep the tree shallow
+		if(u8inst[cand[0]].ins_mask & (0xf << (nib*4)))
+			score += 0x10000;
+		if(score > best_score)
+		{
+			best_score = score;
+			best = nib;
+		}
+	}
+
+	n->nib = best;
+	for(i=0; i<16; i++)
+		n->kid[i] = dt_build(val | (i << (best*4)), known | (0xf << (best*4)));
+
+	return n;
+}
+
+static int dt_eval(const struct dt_node *n, ut16 opcode)
+{
+	while(n->leaf < 0)
+		n = n->kid[(opcode >> (n->nib*4)) & 0xf];
+	return n->leaf;
+}
+
+static int dt_equal(const struct dt_node *a, const struct dt_node *b)
+{
+	int i;
+
+	if(a->leaf >= 0 || b->leaf >= 0)
+		return a->leaf == b->leaf;
+	if(a->nib != b->nib)
+		return 0;
+	for(i=0; i<16; i++)
+	{
+		if(!dt_equal(a->kid[i], b->kid[i]))
+			return 0;
+	}
+	return 1;
+}
+
+// merge switch nodes whose children are all identical
+static struct dt_node *dt_fold(struct dt_node *n)
+{
+	int i;
+
+	if(n->leaf >= 0)
+		return n;
+	for(i=0; i<16; i++)
+		n->kid[i] = dt_fold(n->kid[i]);
+	for(i=1; i<16; i++)
+	{
+		if(!dt_equal(n->kid[0], n->kid[i]))
+			return n;
+	}
+	return n->kid[0];
+}
+
+static void indent(int depth)
+{
+	while(depth--)
+		putchar('\t');
+}
+
+static void dt_emit(const struct dt_node *n, int depth)
+{
+	int i, j, dflt=0, cnt, best_cnt=0, done[16]={0};
+
+	if(n->leaf >= 0)
+	{
+		indent(depth);
+		printf("return %d;\t// %s\n", n->leaf, u8inst[n->leaf].name);
+		return;
+	}
+
+	// most common child becomes 'default'
+	for(i=0; i<16; i++)
+	{
+		for(cnt=0, j=0; j<16; j++)
+			cnt += dt_equal(n->kid[i], n->kid[j]);
+		if(cnt > best_cnt)
+		{
+			best_cnt = cnt;
+			dflt = i;
+		}
+	}
+
+	indent(depth);
+	printf("switch((opcode >> %d) & 0xf)\n", n->nib*4);
+	indent(depth);
+	printf("{\n");
+	for(i=0; i<16; i++)
+	{
+		if(done[i] || dt_equal(n->kid[i], n->kid[dflt]))
+			continue;
+		// group nibble values sharing the same subtree
+		for(j=i; j<16; j++)
+		{
+			if(!done[j] && dt_equal(n->kid[i], n->kid[j]))
+			{
+				indent(depth+1);
+				printf("case 0x%x:\n", j);
+				done[j] = 1;
+			}
+		}
+		dt_emit(n->kid[i], depth+2);
+	}
+	indent(depth+1);
+	printf("default:\n");
+	dt_emit(n->kid[dflt], depth+2);
+	indent(depth);
+	printf("}\n");
+}
+
+static int gen_dtree(void)
+{
+	struct dt_node *root;
+	unsigned int w;
+
+	root = dt_fold(dt_build(0, 0));
+
+	for(w=0; w<0x10000; w++)
+	{
+		if(dt_eval(root, w) != scan_inst(w))
+		{
+			fprintf(stderr, "u8_gen: dtree mismatch at %04xh (%d != %d)\n",
+				w, dt_eval(root, w), scan_inst(w));
+			return 1;
+		}
+	}
+
+	printf("/* generated by u8_gen from u8_insn.def - do not edit */\n\n");
+	printf("#include \"u8_disas.h\"\n\n");
+	printf("// get instruction type (e.g. U8_MOV_..) for given opcode\n");
+	printf("int u8_decode_inst(ut16 opcode)\n{\n");
+	dt_emit(root, 1);
+	printf("}\n");
+
+	return 0;
+}
+
+static int gen_scan(void)
+{
+	printf("/* generated by u8_gen from u8_insn.def - do not edit */\n\n");
+	printf("#include \"u8_disas.h\"\n\n");
+	printf("// get instruction type (e.g. U8_MOV_..) for given opcode\n");
+	printf("int u8_decode_inst(ut16 opcode)\n{\n");
+	printf("\tint i;\n\n");
+	printf("\t// iterate through master table of instructions, returning on match\n");
+	printf("\tfor(i=0; i<U8_INS_NUM; i++)\n\t{\n");
+	printf("\t\tif((opcode & u8inst[i].ins_mask) == u8inst[i].ins)\n");
+	printf("\t\t\treturn i;\n\t}\n");
+	printf("\treturn U8_ILL;\n}\n");
+
+	return 0;
+}
+
+// For each high nibble, find the one other nibble that best decides the
+// instruction type on its own. Pairs not decided by those two nibbles
+// are marked 0xff and left to the scalar decoder by u8_classify().
+static int gen_nib(void)
+{
+	static ut8 lut[0x10000];
+	ut8 sel[16], type[16][16], tmp[16];
+	int h, n, v, best_n, best_cnt, cnt;
+	unsigned int w;
+
+	build_lut(lut);
+
+	for(h=0; h<16; h++)
+	{
+		best_n = 0;
+		best_cnt = -1;
+		for(n=0; n<3; n++)
+		{
+			// type is decided if all 4096 words sharing (h, v) agree
+			memset(tmp, 0xfe, sizeof(tmp));
+			for(w=h<<12; w<(h+1)<<12; w++)
+			{
+				v = (w >> (n*4)) & 0xf;
+				if(tmp[v] == 0xfe)
+					tmp[v] = lut[w];
+				else if(tmp[v] != lut[w])
+					tmp[v] = 0xff;
+			}
+			for(cnt=0, v=0; v<16; v++)
+				cnt += (tmp[v] != 0xff);
+			if(cnt > best_cnt)
+			{
+				best_cnt = cnt;
+				best_n = n;
+				memcpy(type[h], tmp, sizeof(tmp));
+			}
+		}
+		sel[h] = best_n;
+	}
+
+	printf("/* generated by u8_gen from u8_insn.def - do not edit */\n\n");
+	printf("#include \"u8_disas.h\"\n\n");
+	printf("// nibble paired with the high nibble to decide instruction type\n");
+	printf("const ut8 u8_nib_sel[16] =\n{\n\t");
+	for(h=0; h<16; h++)
+		printf("%d,%s", sel[h], h < 15 ? " " : "\n");
+	printf("};\n\n");
+
+	printf("// [high nibble][paired nibble] -> instruction type, 0xff if undecided\n");
+	printf("const ut8 u8_nib_type[16][16] =\n{\n");
+	for(h=0; h<16; h++)
+	{
+		printf("\t{");
+		for(v=0; v<16; v++)
+			printf("%3d%s", type[h][v], v < 15 ? ", " : "},\n");
+	}
+	printf("};\n\n");
+
+	printf("// [high nibble][paired nibble] -> length in words, 0 if undecided\n");
+	printf("const ut8 u8_nib_len[16][16] =\n{\n");
+	for(h=0; h<16; h++)
+	{
+		printf("\t{");
+		for(v=0; v<16; v++)
+			printf("%d%s", type[h][v] == 0xff ? 0 : u8inst[type[h][v]].len,
+				v < 15 ? ", " : "},\n");
+	}
+	printf("};\n");
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc == 2 && !strcmp(argv[1], "lut"))
+		return gen_lut();
+	if(argc == 2 && !strcmp(argv[1], "dtree"))
+		return gen_dtree();
+	if(argc == 2 && !strcmp(argv[1], "scan"))
+		return gen_scan();
+	if(argc == 2 && !strcmp(argv[1], "nib"))
+		return gen_nib();
+
+	fprintf(stderr, "usage: %s lut|dtree|scan|nib\n", argv[0]);
+	return 1;
+}
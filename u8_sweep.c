@@ -0,0 +1,158 @@
+/* nX-U8/100 parallel linear sweep - LGPL - Copyright 2020 - cetus9 */
+
+// Linear disassembly of a large image split over several threads.
+// Each chunk is decoded from its own start offset; chunks are then
+// stitched in order. Where the serial stream enters a chunk off its
+// start (a 2-word instruction or DSR prefix straddling the split), the
+// stream is re-decoded one instruction at a time until it lands on an
+// address the chunk also decoded - from there both decodes agree.
+// The result is identical to u8_decode_block() over the whole buffer.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <r_types.h>
+
+#include "u8_disas.h"
+
+// smallest chunk worth a thread, in bytes
+#define SWEEP_MIN_CHUNK		0x4000
+
+struct sweep_chunk
+{
+	const ut8 *buf;
+	int len;
+	ut32 base_addr;
+	int start, end;			// byte offsets of chunk in buf
+	struct u8_block blk;		// instructions decoded from 'start'
+	int n;				// number of entries in blk
+	int max;
+	pthread_t thread;
+	int threaded;
+};
+
+static void *sweep_worker(void *arg)
+{
+	struct sweep_chunk *c = arg;
+
+	c->n = u8_decode_span(c->buf, c->len, c->start, c->end, c->base_addr, &c->blk, c->max);
+	return NULL;
+}
+
+// copy 'cnt' entries from src[from] to dst[at]
+static void block_copy(struct u8_block *dst, int at, const struct u8_block *src, int from, int cnt)
+{
+	memcpy(dst->addr + at, src->addr + from, cnt * sizeof(*dst->addr));
+	memcpy(dst->type + at, src->type + from, cnt * sizeof(*dst->type));
+	memcpy(dst->len + at, src->len + from, cnt * sizeof(*dst->len));
+	memcpy(dst->op1 + at, src->op1 + from, cnt * sizeof(*dst->op1));
+	memcpy(dst->op2 + at, src->op2 + from, cnt * sizeof(*dst->op2));
+	memcpy(dst->s_word + at, src->s_word + from, cnt * sizeof(*dst->s_word));
+	memcpy(dst->prefix + at, src->prefix + from, cnt * sizeof(*dst->prefix));
+}
+
+// append chunk c to out, continuing the serial stream at offset *pos
+//	returns 0 when the stream has ended (buffer end or 'max' reached)
+static int sweep_stitch(struct sweep_chunk *c, struct u8_block *out, int *n, int max, int *pos)
+{
+	ut32 addr;
+	ut8 type, len;
+	ut16 op1, op2, s_word, prefix;
+	struct u8_block one = {&addr, &type, &len, &op1, &op2, &s_word, &prefix};
+	int j=0, cnt;
+
+	while(*pos < c->end)
+	{
+		if(*n >= max)
+			return 0;
+
+		// in step with the chunk's own decode?
+		while(j < c->n && (int)(c->blk.addr[j] - c->base_addr) < *pos)
+			j++;
+		if(j < c->n && (int)(c->blk.addr[j] - c->base_addr) == *pos)
+		{
+			cnt = c->n - j;
+			if(cnt > max - *n)
+				cnt = max - *n;
+			block_copy(out, *n, &c->blk, j, cnt);
+			*n += cnt;
+			*pos = c->blk.addr[j+cnt-1] - c->base_addr + c->blk.len[j+cnt-1];
+
+			// chunk stopped short of its end: buffer end, or out of room
+			return *pos >= c->end && *n < max;
+		}
+
+		// no - decode the straddling instruction serially
+		if(u8_decode_span(c->buf, c->len, *pos, *pos+1, c->base_addr, &one, 1) < 1)
+			return 0;
+		block_copy(out, (*n)++, &one, 0, 1);
+		*pos += len;
+	}
+
+	return 1;
+}
+
+// linear decode of a whole buffer on 'nthreads' threads (0 = one per CPU)
+//	same result as u8_decode_block(); returns -1 if out of memory
+int u8_sweep(const ut8 *buf, int len, ut32 base_addr, struct u8_block *out, int max, int nthreads)
+{
+	struct sweep_chunk *chunk;
+	int nchunks, size, k, n=0, pos=0;
+
+	if(nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	nchunks = len / SWEEP_MIN_CHUNK;
+	if(nchunks > nthreads)
+		nchunks = nthreads;
+	if(nchunks <= 1)
+		return u8_decode_block(buf, len, base_addr, out, max);
+
+	if(!(chunk = calloc(nchunks, sizeof(*chunk))))
+		return -1;
+
+	size = (len / nchunks) & ~1;		// word aligned splits
+	for(k=0; k<nchunks; k++)
+	{
+		chunk[k].buf = buf;
+		chunk[k].len = len;
+		chunk[k].base_addr = base_addr;
+		chunk[k].start = k * size;
+		chunk[k].end = (k == nchunks-1) ? len : (k+1) * size;
+		chunk[k].max = (chunk[k].end - chunk[k].start) / 2 + 1;
+		if(u8_block_alloc(&chunk[k].blk, chunk[k].max) < 0)
+		{
+			n = -1;
+			goto out;
+		}
+	}
+
+	// first chunk runs on the calling thread
+	for(k=1; k<nchunks; k++)
+		chunk[k].threaded = !pthread_create(&chunk[k].thread, NULL, sweep_worker, &chunk[k]);
+	for(k=0; k<nchunks; k++)
+	{
+		if(!chunk[k].threaded)
+			sweep_worker(&chunk[k]);
+	}
+	for(k=1; k<nchunks; k++)
+	{
+		if(chunk[k].threaded)
+			pthread_join(chunk[k].thread, NULL);
+	}
+
+	for(k=0; k<nchunks; k++)
+	{
+		if(!sweep_stitch(&chunk[k], out, &n, max, &pos))
+			break;
+	}
+
+out:
+	for(k=0; k<nchunks; k++)
+		u8_block_free(&chunk[k].blk);
+	free(chunk);
+
+	return n;
+}
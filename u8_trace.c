@@ -0,0 +1,633 @@
+/* nX-U8/100 execution trace - LGPL - Copyright 2020 - cetus9 */
+
+// Binary instruction trace of the emulator (format in u8_trace.h).
+//
+// Recording: records go straight into the current chunk buffer. A full
+// chunk is handed to a writer thread through a single producer, single
+// consumer ring of chunk buffers - two counters, no locks - and the
+// emulator carries on in the next buffer. It only waits if the writer is
+// U8_TRACE_SLOTS chunks behind. Traced runs stay on threaded blocks, on a
+// decode cache of their own whose entries compute every flag and record
+// the instruction after it (h_traced in u8_emu.c). Writing the record is
+// most of the cost: a traced run goes at a third to two fifths of the
+// untraced speed.
+//
+// Reading: the file is mmap'd and indexed by chunk, so seeking to an
+// instruction number decodes at most one chunk.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <r_types.h>
+
+#include "u8_trace.h"
+
+#define CHUNK_HDR_SIZE		(4 + 4 + 8 + STATE_SIZE)
+#define STATE_SIZE		(4 + 16 + 2 + 2 + 2 + 1 + 1 + 1)
+#define REC_MAX			(2 + 5 + 2 + 16 + 1 + 9 + 5 + U8_TRACE_WR_MAX * 6)
+
+struct u8_trace
+{
+	FILE *f;
+	int error;
+
+	// ring of chunk buffers; head and tail only grow
+	ut8 *slot[U8_TRACE_SLOTS];
+	ut32 slot_len[U8_TRACE_SLOTS];
+	ut64 head;			// chunks filled, written by the emulator
+	ut64 tail;			// chunks written out, by the writer
+	int done;
+	pthread_t thread;
+	int threaded;
+
+	// chunk being filled
+	ut8 *buf, *p;
+	ut32 ninsn;
+	ut64 icount;			// of the next record
+
+	// the emulator's decode cache while this one, of traced blocks, is in
+	// use
+	struct u8_emu_ent *icache;
+
+	// state after the last record
+	struct u8_trace_state st;
+	ut32 last_wr;
+
+	// bytes written by the current instruction
+	int nwr;
+	ut32 wr_addr[U8_TRACE_WR_MAX];
+	ut8 wr_val[U8_TRACE_WR_MAX];
+};
+
+static inline ut8 *put_varint(ut8 *p, ut32 v)
+{
+	while(v >= 0x80)
+	{
+		*p++ = v | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+static inline ut8 *put_svarint(ut8 *p, st32 v)
+{
+	return put_varint(p, ((ut32)v << 1) ^ (ut32)(v >> 31));
+}
+
+static inline ut8 *put16(ut8 *p, ut16 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	return p + 2;
+}
+
+static inline ut8 *put32(ut8 *p, ut32 v)
+{
+	p = put16(p, v);
+	return put16(p, v >> 16);
+}
+
+static ut8 *put_state(ut8 *p, const struct u8_trace_state *st)
+{
+	p = put32(p, st->addr);
+	memcpy(p, st->r, 16);
+	p += 16;
+	p = put16(p, st->sp);
+	p = put16(p, st->ea);
+	p = put16(p, st->lr);
+	*p++ = st->lcsr;
+	*p++ = st->psw;
+	*p++ = st->dsr;
+	return p;
+}
+
+static void state_get(struct u8_trace_state *st, const struct u8_emu *e)
+{
+	st->addr = ((ut32)e->csr << 16) | e->pc;
+	memcpy(st->r, e->r, 16);
+	st->sp = e->sp;
+	st->ea = e->ea;
+	st->lr = e->lr;
+	st->lcsr = e->lcsr;
+	st->psw = e->psw;
+	st->dsr = e->dsr;
+}
+
+// writer thread
+//
+static void slot_write(struct u8_trace *t, ut64 i)
+{
+	int k = i % U8_TRACE_SLOTS;
+
+	if(fwrite(t->slot[k], 1, t->slot_len[k], t->f) != t->slot_len[k])
+		t->error = 1;
+}
+
+static void *trace_writer(void *arg)
+{
+	struct u8_trace *t = arg;
+	struct timespec nap = {0, 200000};
+	ut64 tail = t->tail;
+	int done;
+
+	for(;;)
+	{
+		done = __atomic_load_n(&t->done, __ATOMIC_ACQUIRE);
+		if(tail < __atomic_load_n(&t->head, __ATOMIC_ACQUIRE))
+		{
+			slot_write(t, tail);
+			__atomic_store_n(&t->tail, ++tail, __ATOMIC_RELEASE);
+		}
+		else if(done)
+			break;
+		else
+			nanosleep(&nap, NULL);
+	}
+	return NULL;
+}
+
+// chunk handling
+//
+static void chunk_begin(struct u8_trace *t, ut64 icount)
+{
+	struct timespec nap = {0, 50000};
+	ut64 head = t->head;
+
+	// wait for the writer to free the slot
+	while(t->threaded && head - __atomic_load_n(&t->tail, __ATOMIC_ACQUIRE) >= U8_TRACE_SLOTS)
+		nanosleep(&nap, NULL);
+
+	t->buf = t->slot[head % U8_TRACE_SLOTS];
+	t->p = t->buf + 8;			// size and count filled at the end
+	t->p = put32(put32(t->p, icount), icount >> 32);
+	t->p = put_state(t->p, &t->st);
+	t->ninsn = 0;
+	t->last_wr = 0;
+}
+
+static void chunk_end(struct u8_trace *t)
+{
+	ut64 head = t->head;
+
+	put32(t->buf, t->p - t->buf - 4);
+	put32(t->buf + 4, t->ninsn);
+	t->slot_len[head % U8_TRACE_SLOTS] = t->p - t->buf;
+
+	if(t->threaded)
+		__atomic_store_n(&t->head, head + 1, __ATOMIC_RELEASE);
+	else
+	{
+		slot_write(t, head);
+		t->head = t->tail = head + 1;
+	}
+}
+
+// bit n set for each nonzero byte n of x
+static inline ut32 byte_mask(ut64 x)
+{
+	x |= x >> 4;
+	x |= x >> 2;
+	x |= x >> 1;
+	return ((x & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56;
+}
+
+// record one executed instruction; changes are found against the state
+// after the previous record
+void u8_trace_insn(struct u8_trace *t, struct u8_emu *e, ut32 addr, int type)
+{
+	struct u8_trace_state *st = &t->st;
+	ut8 *p = t->p, flags=0, ctl=0;
+	ut64 r0, r1, s0, s1;
+	ut32 regs, m;
+	int i;
+
+	// flags byte filled in last
+	p[1] = type;
+	p = put_svarint(p + 2, addr - st->addr);
+	st->addr = addr;
+
+	// most instructions change a register or two - compare 8 at a time
+	// and turn the differing bytes into mask bits without a loop
+	memcpy(&r0, e->r, 8);
+	memcpy(&r1, e->r + 8, 8);
+	memcpy(&s0, st->r, 8);
+	memcpy(&s1, st->r + 8, 8);
+	if((r0 ^ s0) | (r1 ^ s1))
+	{
+		regs = byte_mask(r0 ^ s0) | byte_mask(r1 ^ s1) << 8;
+		flags |= U8_TR_REGS;
+		p = put16(p, regs);
+		for(m=regs; m; m &= m - 1)
+			*p++ = e->r[__builtin_ctz(m)];
+		memcpy(st->r, e->r, 16);
+	}
+
+	ctl |= e->sp != st->sp ? U8_TR_CTL_SP : 0;
+	ctl |= e->ea != st->ea ? U8_TR_CTL_EA : 0;
+	ctl |= e->lr != st->lr ? U8_TR_CTL_LR : 0;
+	ctl |= e->lcsr != st->lcsr ? U8_TR_CTL_LCSR : 0;
+	ctl |= e->psw != st->psw ? U8_TR_CTL_PSW : 0;
+	ctl |= e->dsr != st->dsr ? U8_TR_CTL_DSR : 0;
+	if(ctl)
+	{
+		flags |= U8_TR_CTL;
+		*p++ = ctl;
+		if(ctl & U8_TR_CTL_SP)
+			p = put16(p, st->sp = e->sp);
+		if(ctl & U8_TR_CTL_EA)
+			p = put16(p, st->ea = e->ea);
+		if(ctl & U8_TR_CTL_LR)
+			p = put16(p, st->lr = e->lr);
+		if(ctl & U8_TR_CTL_LCSR)
+			*p++ = st->lcsr = e->lcsr;
+		if(ctl & U8_TR_CTL_PSW)
+			*p++ = st->psw = e->psw;
+		if(ctl & U8_TR_CTL_DSR)
+			*p++ = st->dsr = e->dsr;
+	}
+
+	if(t->nwr)
+	{
+		flags |= U8_TR_WRITES;
+		p = put_varint(p, t->nwr);
+		for(i=0; i<t->nwr; i++)
+		{
+			p = put_svarint(p, t->wr_addr[i] - t->last_wr);
+			*p++ = t->wr_val[i];
+			t->last_wr = t->wr_addr[i];
+		}
+		t->nwr = 0;
+	}
+
+	*t->p = flags;
+	t->p = p;
+	t->icount++;
+	if(++t->ninsn >= U8_TRACE_CHUNK_INSNS || p > t->buf + U8_TRACE_CHUNK_SIZE - REC_MAX)
+	{
+		chunk_end(t);
+		chunk_begin(t, t->icount);
+	}
+}
+
+// the emulator's own decode cache, set aside while tracing
+struct u8_emu_ent *u8_trace_icache(struct u8_trace *t)
+{
+	return t->icache;
+}
+
+// data memory write by the instruction being executed
+void u8_trace_wr(struct u8_trace *t, ut32 addr, ut8 v)
+{
+	if(t->nwr < U8_TRACE_WR_MAX)
+	{
+		t->wr_addr[t->nwr] = addr;
+		t->wr_val[t->nwr++] = v;
+	}
+}
+
+// Start tracing every instruction u8_emu_run() executes to 'path'. Traced
+// runs still go by block, on a decode cache of their own whose blocks
+// compute every flag and record each instruction; the untraced one is
+// kept for afterwards.
+//	returns -1 if the file cannot be created or out of memory
+int u8_emu_trace_start(struct u8_emu *e, const char *path)
+{
+	struct u8_emu_ent *ent;
+	struct u8_trace *t;
+	ut8 hdr[8];
+	int k;
+
+	if(e->trace)
+		u8_emu_trace_stop(e);
+	if(!(t = calloc(1, sizeof(*t))))
+		return -1;
+	for(k=0; k<U8_TRACE_SLOTS; k++)
+	{
+		if(!(t->slot[k] = malloc(U8_TRACE_CHUNK_SIZE)))
+			goto fail;
+	}
+	if(!(t->icache = calloc(e->rom_size / 2 + 1, sizeof(*t->icache))))
+		goto fail;
+	if(!(t->f = fopen(path, "wb")))
+		goto fail;
+
+	memcpy(hdr, U8_TRACE_MAGIC, 4);
+	put32(hdr + 4, U8_TRACE_VERSION);
+	fwrite(hdr, 1, sizeof(hdr), t->f);
+
+	state_get(&t->st, e);
+	t->threaded = !pthread_create(&t->thread, NULL, trace_writer, t);
+	t->icount = e->icount;
+	chunk_begin(t, t->icount);
+
+	// swapped, t->icache holds the untraced cache from here on
+	ent = e->icache;
+	e->icache = t->icache;
+	t->icache = ent;
+	e->trace = t;
+	return 0;
+
+fail:
+	for(k=0; k<U8_TRACE_SLOTS; k++)
+		free(t->slot[k]);
+	free(t->icache);
+	free(t);
+	return -1;
+}
+
+// flush and close the trace
+//	returns -1 if writing it failed
+int u8_emu_trace_stop(struct u8_emu *e)
+{
+	struct u8_trace *t = e->trace;
+	int k, error;
+
+	if(!t)
+		return 0;
+	if(t->ninsn)
+		chunk_end(t);
+	if(t->threaded)
+	{
+		__atomic_store_n(&t->done, 1, __ATOMIC_RELEASE);
+		pthread_join(t->thread, NULL);
+	}
+	error = t->error | (fclose(t->f) != 0);
+
+	for(k=0; k<U8_TRACE_SLOTS; k++)
+		free(t->slot[k]);
+	free(e->icache);
+	e->icache = t->icache;
+	free(t);
+	e->trace = NULL;
+
+	return error ? -1 : 0;
+}
+
+// Reader
+//
+static inline ut32 get32(const ut8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((ut32)p[3] << 24);
+}
+
+static inline const ut8 *get_varint(const ut8 *p, const ut8 *end, ut32 *v)
+{
+	int shift=0;
+
+	*v = 0;
+	while(p < end && shift < 35)
+	{
+		*v |= (ut32)(*p & 0x7f) << shift;
+		if(!(*p++ & 0x80))
+			return p;
+		shift += 7;
+	}
+	return NULL;
+}
+
+static inline const ut8 *get_svarint(const ut8 *p, const ut8 *end, st32 *v)
+{
+	ut32 u;
+
+	if(!(p = get_varint(p, end, &u)))
+		return NULL;
+	*v = (st32)(u >> 1) ^ -(st32)(u & 1);
+	return p;
+}
+
+static void get_state(const ut8 *p, struct u8_trace_state *st)
+{
+	st->addr = get32(p);
+	memcpy(st->r, p + 4, 16);
+	st->sp = r_read_at_le16(p, 20);
+	st->ea = r_read_at_le16(p, 22);
+	st->lr = r_read_at_le16(p, 24);
+	st->lcsr = p[26];
+	st->psw = p[27];
+	st->dsr = p[28];
+}
+
+// bytes of control register values for a U8_TR_CTL_.. mask
+static inline int ctl_size(ut8 ctl)
+{
+	return __builtin_popcount(ctl) + __builtin_popcount(ctl & (U8_TR_CTL_SP | U8_TR_CTL_EA | U8_TR_CTL_LR));
+}
+
+// position at the start of chunk ci
+static int chunk_load(struct u8_trace_reader *r, ut32 ci)
+{
+	const ut8 *c;
+
+	if(ci >= r->nchunks)
+		return 0;
+	c = r->map + r->chunk[ci].off;
+	r->ci = ci;
+	r->p = c + CHUNK_HDR_SIZE;
+	r->end = c + 4 + get32(c);
+	r->left = r->chunk[ci].ninsn;
+	r->icount = r->chunk[ci].icount;
+	r->last_wr = 0;
+	get_state(c + 16, &r->st);
+	return 1;
+}
+
+//	returns -1 if the file cannot be read or is not a trace
+int u8_trace_open(struct u8_trace_reader *r, const char *path)
+{
+	struct stat st;
+	size_t off, size;
+	ut32 n=0, max=0;
+	void *m;
+	int fd;
+
+	memset(r, 0, sizeof(*r));
+	if((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	if(fstat(fd, &st) < 0 || st.st_size < 8)
+	{
+		close(fd);
+		return -1;
+	}
+	r->size = st.st_size;
+	m = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(m == MAP_FAILED)
+		return -1;
+	r->map = m;
+	if(memcmp(r->map, U8_TRACE_MAGIC, 4) || get32(r->map + 4) != U8_TRACE_VERSION)
+		goto fail;
+	madvise(m, r->size, MADV_SEQUENTIAL);
+
+	// chunk index - a truncated last chunk is dropped
+	for(off=8; off + CHUNK_HDR_SIZE <= r->size; off += 4 + size)
+	{
+		size = get32(r->map + off);
+		if(size < CHUNK_HDR_SIZE - 4 || size > r->size - off - 4)
+			break;
+		if(n == max)
+		{
+			struct u8_trace_chunk *c;
+
+			max = max ? max * 2 : 64;
+			if(!(c = realloc(r->chunk, max * sizeof(*c))))
+				goto fail;
+			r->chunk = c;
+		}
+		r->chunk[n].off = off;
+		r->chunk[n].ninsn = get32(r->map + off + 4);
+		r->chunk[n].icount = get32(r->map + off + 8) | (ut64)get32(r->map + off + 12) << 32;
+		n++;
+	}
+	r->nchunks = n;
+	chunk_load(r, 0);
+	return 0;
+
+fail:
+	u8_trace_close(r);
+	return -1;
+}
+
+void u8_trace_close(struct u8_trace_reader *r)
+{
+	if(r->map)
+		munmap((void *)r->map, r->size);
+	free(r->chunk);
+	memset(r, 0, sizeof(*r));
+}
+
+// decode the next record
+//	returns 1, 0 at the end of the trace, -1 if it is corrupt
+int u8_trace_next(struct u8_trace_reader *r, struct u8_trace_rec *rec)
+{
+	struct u8_trace_state *st = &r->st;
+	const ut8 *p, *end;
+	ut32 n;
+	st32 d;
+	ut8 flags;
+	int i;
+
+	while(!r->left)
+	{
+		if(!chunk_load(r, r->ci + 1))
+			return 0;
+	}
+	p = r->p;
+	end = r->end;
+	if(end - p < 3)
+		return -1;
+
+	flags = *p++;
+	rec->type = *p++;
+	if(!(p = get_svarint(p, end, &d)))
+		return -1;
+	st->addr += d;
+	rec->addr = st->addr;
+	rec->icount = r->icount;
+	rec->regs = rec->ctl = 0;
+	rec->nwr = 0;
+
+	if(flags & U8_TR_REGS)
+	{
+		if(end - p < 2)
+			return -1;
+		rec->regs = r_read_le16(p);
+		p += 2;
+		for(i=0; i<16; i++)
+		{
+			if(!(rec->regs & (1 << i)))
+				continue;
+			if(p >= end)
+				return -1;
+			st->r[i] = *p++;
+		}
+	}
+	if(flags & U8_TR_CTL)
+	{
+		if(p >= end)
+			return -1;
+		rec->ctl = *p++;
+		if(end - p < ctl_size(rec->ctl))
+			return -1;
+		if(rec->ctl & U8_TR_CTL_SP)
+			st->sp = r_read_le16(p), p += 2;
+		if(rec->ctl & U8_TR_CTL_EA)
+			st->ea = r_read_le16(p), p += 2;
+		if(rec->ctl & U8_TR_CTL_LR)
+			st->lr = r_read_le16(p), p += 2;
+		if(rec->ctl & U8_TR_CTL_LCSR)
+			st->lcsr = *p++;
+		if(rec->ctl & U8_TR_CTL_PSW)
+			st->psw = *p++;
+		if(rec->ctl & U8_TR_CTL_DSR)
+			st->dsr = *p++;
+	}
+	if(flags & U8_TR_WRITES)
+	{
+		if(!(p = get_varint(p, end, &n)) || n > U8_TRACE_WR_MAX)
+			return -1;
+		for(i=0; i<(int)n; i++)
+		{
+			if(!(p = get_svarint(p, end, &d)) || p >= end)
+				return -1;
+			r->last_wr += d;
+			rec->wr_addr[i] = r->last_wr;
+			rec->wr_val[i] = *p++;
+		}
+		rec->nwr = n;
+	}
+	rec->st = *st;
+
+	r->p = p;
+	r->left--;
+	r->icount++;
+	return 1;
+}
+
+// position so the next record is instruction number 'icount'
+//	returns 0 if the trace does not have it
+int u8_trace_seek(struct u8_trace_reader *r, ut64 icount)
+{
+	struct u8_trace_rec rec;
+	ut32 lo=0, hi=r->nchunks, mid;
+
+	// last chunk starting at or before icount
+	while(hi - lo > 1)
+	{
+		mid = (lo + hi) / 2;
+		if(r->chunk[mid].icount <= icount)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	if(!chunk_load(r, lo) || icount < r->icount || icount >= r->icount + r->left)
+		return 0;
+
+	while(r->icount < icount)
+	{
+		if(u8_trace_next(r, &rec) <= 0)
+			return 0;
+	}
+	return 1;
+}
+
+// next record executing the instruction at CSR:PC 'addr'
+//	returns 1, 0 if there is none, -1 if the trace is corrupt
+int u8_trace_find_pc(struct u8_trace_reader *r, ut32 addr, struct u8_trace_rec *rec)
+{
+	int ret;
+
+	while((ret = u8_trace_next(r, rec)) > 0)
+	{
+		if(rec->addr == addr)
+			return 1;
+	}
+	return ret;
+}
@@ -0,0 +1,109 @@
+/* nX-U8/100 execution trace - LGPL - Copyright 2020 - cetus9 */
+
+#ifndef U8_TRACE_H
+#define U8_TRACE_H
+
+#include <r_types.h>
+
+#include "u8_emu.h"
+
+// File: "U8TR", ut32 version, then chunks. A chunk starts with its
+// payload size, instruction count, the icount of its first instruction and
+// a keyframe of the full CPU state, so a reader can skip to any chunk
+// without decoding the ones before it. Records follow, one per instruction:
+//
+//	flags		U8_TR_..
+//	type		U8_.. instruction id
+//	pc		zigzag varint, delta from the previous record's CSR:PC
+//	[regs]		ut16 mask of R0-R15 changed, then their new values
+//	[ctl]		ut8 mask of control registers changed (U8_TR_CTL_..),
+//			then their new values, 16-bit ones little endian
+//	[writes]	varint count, then per byte: zigzag varint address delta
+//			from the previous write, value
+//
+// All multi-byte fixed fields are little endian.
+
+#define U8_TRACE_MAGIC		"U8TR"
+#define U8_TRACE_VERSION	1
+
+#define U8_TRACE_CHUNK_INSNS	4096		// instructions per chunk, at most
+#define U8_TRACE_CHUNK_SIZE	0x40000		// chunk buffer
+#define U8_TRACE_SLOTS		8		// chunks queued for the writer thread
+#define U8_TRACE_WR_MAX		16		// bytes written by one instruction
+
+// record flags
+#define U8_TR_REGS		0x01
+#define U8_TR_CTL		0x02
+#define U8_TR_WRITES		0x04
+
+// control register mask bits
+#define U8_TR_CTL_SP		0x01
+#define U8_TR_CTL_EA		0x02
+#define U8_TR_CTL_LR		0x04
+#define U8_TR_CTL_LCSR		0x08
+#define U8_TR_CTL_PSW		0x10
+#define U8_TR_CTL_DSR		0x20
+
+// CPU state carried through a trace
+struct u8_trace_state
+{
+	ut32 addr;		// CSR:PC of the last instruction
+	ut8 r[16];
+	ut16 sp;
+	ut16 ea;
+	ut16 lr;
+	ut8 lcsr;
+	ut8 psw;
+	ut8 dsr;
+};
+
+// one decoded record
+struct u8_trace_rec
+{
+	ut64 icount;		// instruction number
+	ut32 addr;		// CSR:PC
+	ut8 type;		// U8_..
+	ut16 regs;		// R0-R15 changed
+	ut8 ctl;		// U8_TR_CTL_.. changed
+	int nwr;
+	ut32 wr_addr[U8_TRACE_WR_MAX];
+	ut8 wr_val[U8_TRACE_WR_MAX];
+	struct u8_trace_state st;	// after the instruction
+};
+
+struct u8_trace_chunk
+{
+	size_t off;		// of the chunk header in the file
+	ut64 icount;		// first instruction
+	ut32 ninsn;
+};
+
+struct u8_trace_reader
+{
+	const ut8 *map;
+	size_t size;
+	struct u8_trace_chunk *chunk;
+	ut32 nchunks;
+
+	// position
+	ut32 ci;		// current chunk
+	const ut8 *p, *end;	// records left in it
+	ut32 left;
+	ut64 icount;		// of the next record
+	ut32 last_wr;
+	struct u8_trace_state st;
+};
+
+// recording, see u8_emu_trace_start()
+struct u8_trace;
+void u8_trace_insn(struct u8_trace *t, struct u8_emu *e, ut32 addr, int type);
+void u8_trace_wr(struct u8_trace *t, ut32 addr, ut8 v);
+struct u8_emu_ent *u8_trace_icache(struct u8_trace *t);
+
+int u8_trace_open(struct u8_trace_reader *r, const char *path);
+void u8_trace_close(struct u8_trace_reader *r);
+int u8_trace_next(struct u8_trace_reader *r, struct u8_trace_rec *rec);
+int u8_trace_seek(struct u8_trace_reader *r, ut64 icount);
+int u8_trace_find_pc(struct u8_trace_reader *r, ut32 addr, struct u8_trace_rec *rec);
+
+#endif /* U8_TRACE_H */
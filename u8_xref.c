@@ -0,0 +1,286 @@
+/* nX-U8/100 cross-reference index - LGPL - Copyright 2020 - cetus9 */
+
+// Every code and direct data reference in the code u8_disc found, from
+// one sweep over its decoded instruction bits. The refs are counted per
+// target, the counts summed into an offset table, and the refs dropped
+// into place - sorted by target with no comparison sort, and by source
+// within a target since the sweep runs in address order. Callers of an
+// address are then one table lookup.
+//
+// Data refs are the absolute address forms: *_DA, *_D16_ER (the 16-bit
+// displacement, usually a table base) and sb/rb/tb Dbitadr. Their segment
+// is known for no prefix (0) or 'dsr #seg:'; refs through 'dsr r:' or
+// 'dsr:' depend on run time state and are left out.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <r_types.h>
+
+#include "u8_xref.h"
+
+// Reference made by one decoded instruction at code address 'addr'; swi is
+// resolved to its handler through the vector table in 'rom'.
+//	returns U8_XREF_.., or -1 if none; target in *to
+int u8_xref_insn(const struct u8_cmd *cmd, ut32 addr, const ut8 *rom, ut32 size, ut32 *to)
+{
+	ut32 jump, fail, seg=0;
+	int type;
+
+	switch(u8_flow(cmd, addr, &jump, &fail))
+	{
+		case U8_FLOW_CALL:
+			*to = jump;
+			return U8_XREF_CALL;
+		case U8_FLOW_JMP:
+			*to = jump;
+			return U8_XREF_JUMP;
+		case U8_FLOW_CJMP:
+			*to = jump;
+			return U8_XREF_CJMP;
+		case U8_FLOW_SWI:
+			if((*to = u8_vector_target(rom, size, jump)) == U8_NO_ADDR)
+				return -1;
+			return U8_XREF_CALL;
+	}
+
+	switch(cmd->type)
+	{
+		case U8_L_ER_DA: case U8_L_R_DA: case U8_L_ER_D16_ER: case U8_L_R_D16_ER:
+		case U8_TB_DBIT:
+			type = U8_XREF_READ;
+			break;
+		case U8_ST_ER_DA: case U8_ST_R_DA: case U8_ST_ER_D16_ER: case U8_ST_R_D16_ER:
+		case U8_SB_DBIT: case U8_RB_DBIT:
+			type = U8_XREF_WRITE;
+			break;
+		case U8_LEA_DA: case U8_LEA_D16_ER:
+			type = U8_XREF_ADDR;
+			break;
+		default:
+			return -1;
+	}
+
+	if(cmd->prefix)
+	{
+		if(u8_decode_inst(cmd->prefix) != U8_PRE_PSEG)
+			return -1;
+		seg = cmd->prefix & 0xff;
+	}
+	*to = seg << 16 | cmd->s_word;
+	return type;
+}
+
+static int xref_cmp(const void *a, const void *b)
+{
+	const struct u8_xref *x = a, *y = b;
+
+	if(x->to != y->to)
+		return x->to < y->to ? -1 : 1;
+	return U8_XREF_FROM(x) < U8_XREF_FROM(y) ? -1 : U8_XREF_FROM(x) > U8_XREF_FROM(y);
+}
+
+int u8_xref_build(struct u8_xrefs *x, const struct u8_disc *d)
+{
+	struct u8_xref *tmp, *p;
+	struct u8_cmd cmd;
+	ut32 i, addr, to, n=0, max=0, words = (d->size + 1) / 2, hi, lo;
+	int type;
+
+	memset(x, 0, sizeof(*x));
+	if(!(x->off = calloc(U8_XREF_SPACE + 1, sizeof(*x->off))))
+		return -1;
+
+	// sweep: refs in source order, counted per target
+	tmp = NULL;
+	for(i=0; i<words; i++)
+	{
+		if(!(i & 7) && !d->insn[i >> 3])
+		{
+			i += 7;
+			continue;
+		}
+		if(!((d->insn[i >> 3] >> (i & 7)) & 1))
+			continue;
+		addr = i * 2;
+		if(u8_decode(d->rom + addr, d->size - addr, &cmd) < 0)
+			continue;
+		if((type = u8_xref_insn(&cmd, addr, d->rom, d->size, &to)) < 0)
+			continue;
+
+		if(n == max)
+		{
+			max = max ? max * 2 : 4096;
+			if(!(p = realloc(tmp, max * sizeof(*p))))
+			{
+				free(tmp);
+				u8_xref_free(x);
+				return -1;
+			}
+			tmp = p;
+		}
+		tmp[n].from = (ut32)type << 24 | addr;
+		tmp[n++].to = to;
+		if(to < U8_XREF_SPACE)
+			x->off[to]++;
+	}
+
+	// counts to start offsets; refs past the table go at the end
+	for(i=0, lo=0; i<=U8_XREF_SPACE; i++)
+	{
+		hi = x->off[i];
+		x->off[i] = lo;
+		lo += hi;
+	}
+	if(n && !(x->ref = malloc(n * sizeof(*x->ref))))
+	{
+		free(tmp);
+		u8_xref_free(x);
+		return -1;
+	}
+	x->nrefs = n;
+
+	// place; off[t] ends up at the end of t's refs, the start of t+1's
+	hi = lo;
+	for(i=0; i<n; i++)
+	{
+		if(tmp[i].to < U8_XREF_SPACE)
+			x->ref[x->off[tmp[i].to]++] = tmp[i];
+		else
+			x->ref[hi++] = tmp[i];
+	}
+	memmove(x->off + 1, x->off, U8_XREF_SPACE * sizeof(*x->off));
+	x->off[0] = 0;
+	free(tmp);
+
+	// the few refs above the table
+	qsort(x->ref + lo, n - lo, sizeof(*x->ref), xref_cmp);
+	return 0;
+}
+
+// Bring 'x' up to date after u8_disc_update(): refs from the words it
+// re-derived (d->dirty) are dropped and made again, the rest kept. Both
+// lists are in (target, source) order, so one merge puts them together.
+//	returns 0, or -1 if out of memory ('x' is then unchanged)
+int u8_xref_update(struct u8_xrefs *x, const struct u8_disc *d)
+{
+	struct u8_xref *tmp=NULL, *ref, *p;
+	struct u8_cmd cmd;
+	ut32 *off, i, j, k, addr, to, n=0, max=0, words = (d->size + 1) / 2;
+	int type;
+
+	if(!d->dirty || !x->off)
+		return -1;
+
+	// refs made by the re-derived words
+	for(i=0; i<words; i++)
+	{
+		if(!(i & 7) && !(d->dirty[i >> 3] & d->insn[i >> 3]))
+		{
+			i += 7;
+			continue;
+		}
+		if(!((d->dirty[i >> 3] & d->insn[i >> 3]) >> (i & 7) & 1))
+			continue;
+		addr = i * 2;
+		if(u8_decode(d->rom + addr, d->size - addr, &cmd) < 0)
+			continue;
+		if((type = u8_xref_insn(&cmd, addr, d->rom, d->size, &to)) < 0)
+			continue;
+
+		if(n == max)
+		{
+			max = max ? max * 2 : 256;
+			if(!(p = realloc(tmp, max * sizeof(*p))))
+			{
+				free(tmp);
+				return -1;
+			}
+			tmp = p;
+		}
+		tmp[n].from = (ut32)type << 24 | addr;
+		tmp[n++].to = to;
+	}
+	if(n)				// tmp is still NULL otherwise
+		qsort(tmp, n, sizeof(*tmp), xref_cmp);
+
+	ref = malloc((x->nrefs + n + 1) * sizeof(*ref));
+	off = malloc((U8_XREF_SPACE + 1) * sizeof(*off));
+	if(!ref || !off)
+	{
+		free(ref);
+		free(off);
+		free(tmp);
+		return -1;
+	}
+
+	// merge with the refs kept, offsets filled in on the way
+	for(i=0, j=0, k=0, to=0; i < x->nrefs || j < n; )
+	{
+		if(i < x->nrefs)
+		{
+			addr = U8_XREF_FROM(&x->ref[i]);
+			if(U8_DISC_BIT(d->dirty, addr))
+			{
+				i++;
+				continue;
+			}
+		}
+		if(j == n || (i < x->nrefs && xref_cmp(&x->ref[i], &tmp[j]) < 0))
+			p = &x->ref[i++];
+		else
+			p = &tmp[j++];
+		for(; to <= p->to && to <= U8_XREF_SPACE; to++)
+			off[to] = k;
+		ref[k++] = *p;
+	}
+	for(; to <= U8_XREF_SPACE; to++)
+		off[to] = k;
+	free(tmp);
+
+	u8_xref_free(x);
+	x->ref = ref;
+	x->nrefs = k;
+	x->off = off;
+	return 0;
+}
+
+void u8_xref_free(struct u8_xrefs *x)
+{
+	if(!x->mapped)
+	{
+		free(x->ref);
+		free(x->off);
+	}
+	memset(x, 0, sizeof(*x));
+}
+
+// refs to 'addr', sorted by source; *n set to their number
+const struct u8_xref *u8_xref_to(const struct u8_xrefs *x, ut32 addr, ut32 *n)
+{
+	ut32 lo, hi, mid;
+
+	*n = 0;
+	if(!x->off)
+		return NULL;
+	if(addr < U8_XREF_SPACE)
+	{
+		*n = x->off[addr+1] - x->off[addr];
+		return x->ref + x->off[addr];
+	}
+
+	lo = x->off[U8_XREF_SPACE];
+	hi = x->nrefs;
+	while(lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if(x->ref[mid].to < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for(mid=lo; mid < x->nrefs && x->ref[mid].to == addr; mid++)
+		;
+	*n = mid - lo;
+	return x->ref + lo;
+}
@@ -0,0 +1,52 @@
+/* nX-U8/100 cross-reference index - LGPL - Copyright 2020 - cetus9 */
+
+#ifndef U8_XREF_H
+#define U8_XREF_H
+
+#include <r_types.h>
+
+#include "u8_disc.h"
+
+// reference kinds
+enum
+{
+	U8_XREF_CALL,		// bl, swi (to the handler)
+	U8_XREF_JUMP,		// b, bal
+	U8_XREF_CJMP,		// conditional branch
+	U8_XREF_READ,		// l, tb
+	U8_XREF_WRITE,		// st, sb, rb
+	U8_XREF_ADDR,		// lea
+};
+
+// Source address in the low 24 bits, kind in the top 8. Data targets
+// carry their segment (from a 'dsr #seg:' prefix, else 0) in bits 16-23.
+struct u8_xref
+{
+	ut32 from;
+	ut32 to;
+};
+
+#define U8_XREF_FROM(x)		((x)->from & 0xffffff)
+#define U8_XREF_TYPE(x)		((x)->from >> 24)
+
+// targets below this get a slot in the offset table; the rest (data in
+// segments 10h and up) are found by binary search
+#define U8_XREF_SPACE		0x100000
+
+// refs sorted by target, then source; refs to address a < U8_XREF_SPACE
+// are ref[off[a]] .. ref[off[a+1]-1]
+struct u8_xrefs
+{
+	struct u8_xref *ref;
+	ut32 nrefs;
+	ut32 *off;		// U8_XREF_SPACE + 1 entries
+	int mapped;		// in a cache file (u8_db_load()), not ours to free
+};
+
+int u8_xref_build(struct u8_xrefs *x, const struct u8_disc *d);
+int u8_xref_update(struct u8_xrefs *x, const struct u8_disc *d);
+void u8_xref_free(struct u8_xrefs *x);
+const struct u8_xref *u8_xref_to(const struct u8_xrefs *x, ut32 addr, ut32 *n);
+int u8_xref_insn(const struct u8_cmd *cmd, ut32 addr, const ut8 *rom, ut32 size, ut32 *to);
+
+#endif /* U8_XREF_H */
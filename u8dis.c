@@ -0,0 +1,173 @@
+/* nX-U8/100 command line disassembler - LGPL - Copyright 2020 - cetus9 */
+
+// Linear listing of a ROM image, for batch use where starting r2 per file
+// is too slow. Built on libu8dis.a; needs no r2 install.
+//
+//	u8dis [-b base] [-s start] [-e end] [-n] [-u] [-x] rom.bin
+//
+//	-b base		address of the first byte of the file (e.g. 10000 for
+//			a segment 1 image), default 0
+//	-s start	first address to list, default base
+//	-e end		address to stop at (exclusive), default end of file
+//	-n		no instruction bytes column
+//	-u		uppercase mnemonics and operands
+//	-x		0x1f style hex rather than 1fh
+//
+// Numbers are hex. The file is mmap'd and output goes out through a large
+// buffer, with no printf on the per-instruction path.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <r_types.h>
+
+#include "u8_disas.h"
+
+#define OUT_SIZE	(1 << 20)	// flush output at this size
+#define OUT_LINE_MAX	96		// longest listing line
+
+static char out_buf[OUT_SIZE];
+static int out_len;
+
+static int out_flush(void)
+{
+	int done=0, ret;
+
+	while(done < out_len)
+	{
+		ret = write(STDOUT_FILENO, out_buf + done, out_len - done);
+		if(ret <= 0)
+			return -1;
+		done += ret;
+	}
+	out_len = 0;
+	return 0;
+}
+
+static inline char *put_hex(char *p, unsigned int v, int digits)
+{
+	while(digits--)
+		*p++ = "0123456789abcdef"[(v >> (digits*4)) & 0xf];
+	return p;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: u8dis [-b base] [-s start] [-e end] [-n] [-u] [-x] rom.bin\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct u8_cmd cmd;
+	struct stat st;
+	const ut8 *rom;
+	ut32 base=0, start=0, end=0, addr;
+	int c, fd, pos, stop, ret, i, style=0, bytes=1, has_start=0, has_end=0, err=0;
+	char *p;
+
+	while((c = getopt(argc, argv, "b:s:e:nux")) != -1)
+	{
+		switch(c)
+		{
+			case 'b':
+				base = strtoul(optarg, NULL, 16); break;
+			case 's':
+				start = strtoul(optarg, NULL, 16); has_start = 1; break;
+			case 'e':
+				end = strtoul(optarg, NULL, 16); has_end = 1; break;
+			case 'n':
+				bytes = 0; break;
+			case 'u':
+				style |= U8_STYLE_UPPER; break;
+			case 'x':
+				style |= U8_STYLE_CHEX; break;
+			default:
+				usage();
+		}
+	}
+	if(optind != argc - 1)
+		usage();
+
+	if((fd = open(argv[optind], O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	if(st.st_size == 0)
+		return 0;
+	rom = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(rom == MAP_FAILED)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	madvise((void *)rom, st.st_size, MADV_SEQUENTIAL);
+
+	// range as byte offsets into the file, word aligned
+	pos = has_start && start > base ? (start - base) & ~1 : 0;
+	stop = st.st_size & ~1;
+	if(has_end && end < base + stop)
+		stop = end > base ? end - base : 0;
+
+	while(pos < stop)
+	{
+		ret = u8_decode(rom + pos, stop - pos, &cmd);
+		if(ret < 0)
+		{
+			// truncated at end of range - list remaining words as data
+			memset(&cmd, 0, sizeof(cmd));
+			cmd.type = U8_ILL;
+			cmd.opcode = r_read_at_le16(rom, pos);
+			ret = 2;
+		}
+
+		if(out_len > OUT_SIZE - OUT_LINE_MAX && (err = out_flush()) < 0)
+			break;
+
+		addr = base + pos;
+		p = out_buf + out_len;
+		p = put_hex(p, addr, addr > 0xfffff ? 8 : 5);
+		*p++ = ' ';
+		*p++ = ' ';
+		if(bytes)
+		{
+			for(i=0; i<6; i+=2)
+			{
+				if(i < ret)
+					p = put_hex(p, r_read_at_le16(rom, pos + i), 4);
+				else
+				{
+					memset(p, ' ', 4);
+					p += 4;
+				}
+				*p++ = ' ';
+			}
+			*p++ = ' ';
+		}
+		p += u8_format_style(&cmd, p, out_buf + OUT_SIZE - p, style);
+		if(p[-1] == ' ')		// no operands
+			p--;
+		*p++ = '\n';
+		out_len = p - out_buf;
+
+		pos += ret;
+	}
+
+	if(!err)
+		err = out_flush();
+	munmap((void *)rom, st.st_size);
+	close(fd);
+
+	if(err)
+	{
+		perror("u8dis: write");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,162 @@
+/* nX-U8/100 execution trace listing - LGPL - Copyright 2020 - cetus9 */
+
+// Lists a trace written by u8_emu_trace_start(), one line per executed
+// instruction with what it changed:
+//
+//	u8trace [-i icount] [-p addr] [-n count] [-u] [-x] rom.bin trace.bin
+//
+//	-i icount	start at this instruction number (decimal); seeks by
+//			chunk, so it does not decode the trace before it
+//	-p addr		only instructions at this CSR:PC address (hex)
+//	-n count	stop after this many lines
+//	-u		uppercase mnemonics and operands
+//	-x		0x1f style hex rather than 1fh
+//
+// rom.bin is the image the trace was recorded on, loaded at address 0; it
+// is only used to show the instructions.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <r_types.h>
+
+#include "u8_disas.h"
+#include "u8_trace.h"
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: u8trace [-i icount] [-p addr] [-n count] [-u] [-x] rom.bin trace.bin\n");
+	exit(1);
+}
+
+static void print_rec(const struct u8_trace_rec *rec, const ut8 *rom, size_t rom_size, int style)
+{
+	const struct u8_trace_state *st = &rec->st;
+	struct u8_cmd cmd;
+	char buf[64];
+	int i, n=0;
+
+	if(rec->addr < rom_size && u8_decode(rom + rec->addr, rom_size - rec->addr, &cmd) >= 0)
+	{
+		n = u8_format_style(&cmd, buf, sizeof(buf), style);
+		if(n && buf[n-1] == ' ')
+			n--;
+	}
+	else
+		n = snprintf(buf, sizeof(buf), "?");
+	buf[n] = 0;
+
+	printf("%10" PFMT64u "  %05x  ", rec->icount, rec->addr);
+	if(rec->regs || rec->ctl || rec->nwr)
+		printf("%-28s ;", buf);
+	else
+		fputs(buf, stdout);
+
+	for(i=0; i<16; i++)
+	{
+		if(rec->regs & (1 << i))
+			printf(" r%d=%02x", i, st->r[i]);
+	}
+	if(rec->ctl & U8_TR_CTL_SP)
+		printf(" sp=%04x", st->sp);
+	if(rec->ctl & U8_TR_CTL_EA)
+		printf(" ea=%04x", st->ea);
+	if(rec->ctl & U8_TR_CTL_LR)
+		printf(" lr=%04x", st->lr);
+	if(rec->ctl & U8_TR_CTL_LCSR)
+		printf(" lcsr=%02x", st->lcsr);
+	if(rec->ctl & U8_TR_CTL_PSW)
+		printf(" psw=%02x", st->psw);
+	if(rec->ctl & U8_TR_CTL_DSR)
+		printf(" dsr=%02x", st->dsr);
+	for(i=0; i<rec->nwr; i++)
+		printf(" [%05x]=%02x", rec->wr_addr[i], rec->wr_val[i]);
+	putchar('\n');
+}
+
+int main(int argc, char **argv)
+{
+	static char out_buf[1 << 20];
+	struct u8_trace_reader r;
+	struct u8_trace_rec rec;
+	struct stat st;
+	const ut8 *rom=MAP_FAILED;
+	ut64 icount=0, count=0, shown=0;
+	ut32 pc=0;
+	int c, fd, ret, style=0, has_pc=0;
+
+	while((c = getopt(argc, argv, "i:p:n:ux")) != -1)
+	{
+		switch(c)
+		{
+			case 'i':
+				icount = strtoull(optarg, NULL, 10); break;
+			case 'p':
+				pc = strtoul(optarg, NULL, 16); has_pc = 1; break;
+			case 'n':
+				count = strtoull(optarg, NULL, 10); break;
+			case 'u':
+				style |= U8_STYLE_UPPER; break;
+			case 'x':
+				style |= U8_STYLE_CHEX; break;
+			default:
+				usage();
+		}
+	}
+	if(optind != argc - 2)
+		usage();
+
+	if((fd = open(argv[optind], O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	if(st.st_size)
+		rom = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(rom == MAP_FAILED)
+	{
+		rom = NULL;
+		st.st_size = 0;
+	}
+
+	if(u8_trace_open(&r, argv[optind+1]) < 0)
+	{
+		fprintf(stderr, "%s: not a trace\n", argv[optind+1]);
+		return 1;
+	}
+	if(icount && !u8_trace_seek(&r, icount))
+	{
+		fprintf(stderr, "instruction %" PFMT64u " is not in the trace\n", icount);
+		u8_trace_close(&r);
+		return 1;
+	}
+
+	setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
+	while(!count || shown < count)
+	{
+		if(has_pc)
+			ret = u8_trace_find_pc(&r, pc, &rec);
+		else
+			ret = u8_trace_next(&r, &rec);
+		if(ret <= 0)
+		{
+			if(ret < 0)
+				fprintf(stderr, "%s: corrupt at instruction %" PFMT64u "\n", argv[optind+1], r.icount);
+			break;
+		}
+		print_rec(&rec, rom, st.st_size, style);
+		shown++;
+	}
+	fflush(stdout);
+
+	u8_trace_close(&r);
+	if(rom)
+		munmap((void *)rom, st.st_size);
+	return 0;
+}